@@ -0,0 +1,176 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+//a width x height board where winLength in a row wins, the 3x3 game is just the smallest case
+
+constexpr int MaxBoardWidth = 19;
+constexpr int MaxBoardCells = MaxBoardWidth * MaxBoardWidth;
+
+//same values the game uses in boardState: 1 is the CPU's O, 2 is the player's X
+constexpr int8_t PieceNone = 0;
+constexpr int8_t PieceO = 1;
+constexpr int8_t PieceX = 2;
+
+[[nodiscard]]
+constexpr int8_t OtherPiece(int8_t piece) noexcept
+{
+	return piece == PieceO ? PieceX : PieceO;
+}
+
+[[nodiscard]]
+constexpr uint64_t SplitMix64(uint64_t& state) noexcept
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+//one key per cell per piece, the last entry is xored in whenever the side to move changes
+inline constexpr std::array<uint64_t, MaxBoardCells * 2 + 1> ZobristKeys = []
+{
+	std::array<uint64_t, MaxBoardCells * 2 + 1> keys = {};
+	uint64_t state = 0x7469637461637465ull;
+	for (uint64_t& key : keys)
+		key = SplitMix64(state);
+	return keys;
+}();
+
+[[nodiscard]]
+constexpr uint64_t ZobristKey(int cell, int8_t piece) noexcept
+{
+	return ZobristKeys[cell * 2 + (piece - 1)];
+}
+
+constexpr uint64_t ZobristSideKey = ZobristKeys[MaxBoardCells * 2];
+
+struct Board
+{
+	int width;
+	int height;
+	int winLength;
+	int moveCount;
+	//the first setupCount moves were put there rather than played, so undoing them doesn't pass the turn back
+	int setupCount;
+	int8_t toMove;
+	uint64_t hash;
+	int8_t cells[MaxBoardCells];
+	int16_t moves[MaxBoardCells];
+};
+
+inline void BoardInit(Board& board, int width, int height, int winLength, int8_t firstPiece = PieceX) noexcept
+{
+	board.width = width;
+	board.height = height;
+	board.winLength = winLength;
+	board.moveCount = 0;
+	board.setupCount = 0;
+	board.toMove = firstPiece;
+	board.hash = firstPiece == PieceO ? ZobristSideKey : 0;
+
+	for (int i = 0; i < MaxBoardCells; i++)
+		board.cells[i] = PieceNone;
+}
+
+[[nodiscard]]
+constexpr int BoardCellCount(const Board& board) noexcept
+{
+	return board.width * board.height;
+}
+
+[[nodiscard]]
+constexpr bool BoardIsFull(const Board& board) noexcept
+{
+	return board.moveCount == BoardCellCount(board);
+}
+
+inline void BoardPlay(Board& board, int cell) noexcept
+{
+	board.cells[cell] = board.toMove;
+	board.hash ^= ZobristKey(cell, board.toMove) ^ ZobristSideKey;
+	board.moves[board.moveCount++] = (int16_t)cell;
+	board.toMove = OtherPiece(board.toMove);
+}
+
+//places a stone for either side without passing the turn, for setting up positions before any move is played.
+//the stone still goes on the move stack, since the search finds its candidates next to the stones there
+inline void BoardPut(Board& board, int cell, int8_t piece) noexcept
+{
+	board.cells[cell] = piece;
+	board.hash ^= ZobristKey(cell, piece);
+	board.moves[board.moveCount++] = (int16_t)cell;
+	board.setupCount = board.moveCount;
+}
+
+inline void BoardSetToMove(Board& board, int8_t piece) noexcept
+{
+	if (board.toMove != piece)
+		board.hash ^= ZobristSideKey;
+	board.toMove = piece;
+}
+
+inline void BoardUndo(Board& board) noexcept
+{
+	int cell = board.moves[--board.moveCount];
+	board.hash ^= ZobristKey(cell, board.cells[cell]);
+	board.cells[cell] = PieceNone;
+
+	if (board.moveCount < board.setupCount)
+	{
+		board.setupCount = board.moveCount;
+		return;
+	}
+
+	board.toMove = OtherPiece(board.toMove);
+	board.hash ^= ZobristSideKey;
+}
+
+//length of the run through cell along (dx, dy), counting cell itself
+[[nodiscard]]
+inline int BoardRunLength(const Board& board, int cell, int dx, int dy) noexcept
+{
+	int8_t piece = board.cells[cell];
+	int x = cell % board.width;
+	int y = cell / board.width;
+	int length = 1;
+
+	for (int sx = x + dx, sy = y + dy;
+		sx >= 0 && sx < board.width && sy >= 0 && sy < board.height && board.cells[sy * board.width + sx] == piece;
+		sx += dx, sy += dy)
+		length++;
+
+	for (int sx = x - dx, sy = y - dy;
+		sx >= 0 && sx < board.width && sy >= 0 && sy < board.height && board.cells[sy * board.width + sx] == piece;
+		sx -= dx, sy -= dy)
+		length++;
+
+	return length;
+}
+
+constexpr int BoardDirections[4][2] = { { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, -1 } };
+
+//only the 4 lines through the stone just placed can have been completed by it
+[[nodiscard]]
+inline bool BoardIsWinningMove(const Board& board, int cell) noexcept
+{
+	for (const auto& direction : BoardDirections)
+	{
+		if (BoardRunLength(board, cell, direction[0], direction[1]) >= board.winLength)
+			return true;
+	}
+	return false;
+}
+
+[[nodiscard]]
+inline bool BoardLastMoveWon(const Board& board) noexcept
+{
+	return board.moveCount != 0 && BoardIsWinningMove(board, board.moves[board.moveCount - 1]);
+}
@@ -0,0 +1,307 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Game.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+//live games for spectators. every change to a game is encoded once, as a few bytes saying which cell got which piece
+//and what phase the game is in, into a buffer that every spectator of that game is handed by pointer.
+//a channel keeps only its last few messages, a spectator further behind than that gets one snapshot of the game as it
+//is now, so a slow spectator costs nothing extra and nobody's backlog ever grows.
+//everything here belongs to the thread running the games, like the timer wheel
+
+constexpr uint8_t BroadcastDelta = 1;
+constexpr uint8_t BroadcastSnapshot = 2;
+
+//kind, sequence, cell and piece, phase and win line
+constexpr uint8_t BroadcastDeltaBytes = 7;
+//kind, sequence, 2 bits for each cell, phase and win line
+constexpr uint8_t BroadcastSnapshotBytes = 9;
+
+//a power of 2, and more messages than one game takes, so only a spectator a whole game behind needs a snapshot
+constexpr uint32_t BroadcastHistory = 16;
+
+constexpr uint32_t BroadcastBlockBuffers = 1024;
+
+//cell in a delta that only changes the phase or win line
+constexpr uint8_t BroadcastNoCell = 15;
+
+//never written after it's published, so it can be sent to any number of spectators at once
+struct BroadcastBuffer
+{
+	//one for the channel's history while it's in there, and one for every spectator still sending it
+	uint32_t refs;
+	uint8_t length;
+	uint8_t bytes[BroadcastSnapshotBytes];
+	BroadcastBuffer* nextFree;
+};
+
+//what a spectator sees, cells are 0 empty, 1 CPU, 2 player like GameSession, phase is GameSession's gameState
+struct BroadcastState
+{
+	uint8_t cells[9];
+	uint8_t phase;
+	uint8_t winType;
+};
+
+struct BroadcastChannel
+{
+	//the last message's sequence, messages start at 1
+	uint64_t sequence;
+	BroadcastState state;
+	BroadcastBuffer* history[BroadcastHistory];
+
+	//made the first time a spectator needs it after a change, and shared by every spectator that needs it until the next one
+	BroadcastBuffer* snapshot;
+	uint64_t snapshotSequence;
+};
+
+struct BroadcastHub
+{
+	//buffers are handed out by pointer, so they come in blocks that never move
+	std::vector<std::unique_ptr<BroadcastBuffer[]>> blocks;
+	BroadcastBuffer* freeList = nullptr;
+	size_t buffersInUse = 0;
+
+	std::vector<BroadcastChannel> channels;
+};
+
+//all a spectator costs the hub, and all it keeps
+struct BroadcastSubscriber
+{
+	uint32_t channel;
+	//the sequence it wants next, 0 before it has anything
+	uint64_t nextSequence;
+};
+
+inline void BroadcastInit(BroadcastHub& hub, size_t expectedChannels = 16)
+{
+	hub.blocks.clear();
+	hub.freeList = nullptr;
+	hub.buffersInUse = 0;
+
+	hub.channels.clear();
+	hub.channels.reserve(expectedChannels);
+}
+
+[[nodiscard]]
+inline BroadcastBuffer* BroadcastAcquire(BroadcastHub& hub)
+{
+	if (hub.freeList == nullptr)
+	{
+		hub.blocks.push_back(std::make_unique<BroadcastBuffer[]>(BroadcastBlockBuffers));
+		BroadcastBuffer* block = hub.blocks.back().get();
+
+		for (uint32_t i = 0; i < BroadcastBlockBuffers; i++)
+			block[i].nextFree = i + 1 < BroadcastBlockBuffers ? &block[i + 1] : nullptr;
+		hub.freeList = block;
+	}
+
+	BroadcastBuffer* buffer = hub.freeList;
+	hub.freeList = buffer->nextFree;
+	hub.buffersInUse++;
+
+	buffer->refs = 1;
+	buffer->nextFree = nullptr;
+	return buffer;
+}
+
+//call once for every buffer BroadcastPoll handed out, when it's been sent
+inline void BroadcastRelease(BroadcastHub& hub, const BroadcastBuffer* buffer) noexcept
+{
+	if (buffer == nullptr)
+		return;
+
+	BroadcastBuffer* owned = const_cast<BroadcastBuffer*>(buffer);
+	if (--owned->refs != 0)
+		return;
+
+	owned->nextFree = hub.freeList;
+	hub.freeList = owned;
+	hub.buffersInUse--;
+}
+
+[[nodiscard]]
+inline uint32_t BroadcastAddChannel(BroadcastHub& hub)
+{
+	hub.channels.push_back(BroadcastChannel{});
+	return (uint32_t)hub.channels.size() - 1;
+}
+
+[[nodiscard]]
+inline BroadcastState BroadcastStateOf(const GameSession& session) noexcept
+{
+	BroadcastState state;
+	for (int i = 0; i < 9; i++)
+		state.cells[i] = session.boardState[i] < 0 ? 0 : (uint8_t)session.boardState[i];
+
+	state.phase = (uint8_t)session.gameState;
+	state.winType = session.gameState == 3 ? (uint8_t)session.winType : 0;
+	return state;
+}
+
+inline void BroadcastWriteHeader(BroadcastBuffer& buffer, uint8_t kind, uint64_t sequence) noexcept
+{
+	buffer.bytes[0] = kind;
+	for (int i = 0; i < 4; i++)
+		buffer.bytes[1 + i] = (uint8_t)(sequence >> (i * 8));
+}
+
+inline void BroadcastEncodeSnapshot(BroadcastBuffer& buffer, const BroadcastState& state, uint64_t sequence) noexcept
+{
+	BroadcastWriteHeader(buffer, BroadcastSnapshot, sequence);
+
+	uint32_t cells = 0;
+	for (int i = 0; i < 9; i++)
+		cells |= (uint32_t)state.cells[i] << (i * 2);
+
+	buffer.bytes[5] = (uint8_t)cells;
+	buffer.bytes[6] = (uint8_t)(cells >> 8);
+	buffer.bytes[7] = (uint8_t)(cells >> 16);
+	buffer.bytes[8] = (uint8_t)(state.phase | state.winType << 2);
+	buffer.length = BroadcastSnapshotBytes;
+}
+
+inline void BroadcastEncodeDelta(BroadcastBuffer& buffer, const BroadcastState& state, uint8_t cell, uint64_t sequence) noexcept
+{
+	BroadcastWriteHeader(buffer, BroadcastDelta, sequence);
+
+	uint8_t piece = cell == BroadcastNoCell ? 0 : state.cells[cell];
+	buffer.bytes[5] = (uint8_t)(cell | piece << 4);
+	buffer.bytes[6] = (uint8_t)(state.phase | state.winType << 2);
+	buffer.length = BroadcastDeltaBytes;
+}
+
+//the history keeps the newest BroadcastHistory messages, the oldest is dropped as soon as nobody is sending it
+inline void BroadcastPublish(BroadcastHub& hub, BroadcastChannel& channel, BroadcastBuffer* buffer) noexcept
+{
+	BroadcastBuffer*& slot = channel.history[channel.sequence % BroadcastHistory];
+	BroadcastRelease(hub, slot);
+	slot = buffer;
+}
+
+//publishes whatever changed since the last call. a move is one delta, and a cleared board is sent as a snapshot in
+//the stream, since a snapshot is barely bigger than a delta and it takes one for every cell to clear a board.
+//returns how many messages were published
+inline int BroadcastCapture(BroadcastHub& hub, uint32_t channelIndex, const GameSession& session)
+{
+	BroadcastChannel& channel = hub.channels[channelIndex];
+	BroadcastState state = BroadcastStateOf(session);
+
+	int changed = 0;
+	uint8_t changedCell = BroadcastNoCell;
+	bool cleared = false;
+	for (uint8_t i = 0; i < 9; i++)
+	{
+		if (state.cells[i] == channel.state.cells[i])
+			continue;
+
+		changed++;
+		changedCell = i;
+		cleared |= state.cells[i] == 0;
+	}
+
+	if (changed == 0 && state.phase == channel.state.phase && state.winType == channel.state.winType)
+		return 0;
+
+	channel.state = state;
+	channel.sequence++;
+
+	BroadcastBuffer* buffer = BroadcastAcquire(hub);
+	if (changed > 1 || cleared)
+		BroadcastEncodeSnapshot(*buffer, state, channel.sequence);
+	else
+		BroadcastEncodeDelta(*buffer, state, changedCell, channel.sequence);
+
+	BroadcastPublish(hub, channel, buffer);
+	return 1;
+}
+
+//the next message for the spectator, or nullptr when it's up to date. one that has fallen further behind than the
+//history reaches is moved straight to the present with a snapshot. the buffer stays valid until it's released
+[[nodiscard]]
+inline const BroadcastBuffer* BroadcastPoll(BroadcastHub& hub, BroadcastSubscriber& subscriber)
+{
+	BroadcastChannel& channel = hub.channels[subscriber.channel];
+
+	if (subscriber.nextSequence != 0 && subscriber.nextSequence > channel.sequence)
+		return nullptr;
+
+	BroadcastBuffer* buffer;
+	if (subscriber.nextSequence == 0 || channel.sequence - subscriber.nextSequence >= BroadcastHistory)
+	{
+		if (channel.snapshot == nullptr || channel.snapshotSequence != channel.sequence)
+		{
+			BroadcastRelease(hub, channel.snapshot);
+			channel.snapshot = BroadcastAcquire(hub);
+			channel.snapshotSequence = channel.sequence;
+			BroadcastEncodeSnapshot(*channel.snapshot, channel.state, channel.sequence);
+		}
+
+		buffer = channel.snapshot;
+		subscriber.nextSequence = channel.sequence + 1;
+	}
+	else
+	{
+		buffer = channel.history[subscriber.nextSequence % BroadcastHistory];
+		subscriber.nextSequence++;
+	}
+
+	buffer->refs++;
+	return buffer;
+}
+
+//the spectator's side, sequence is the last one applied. returns false for a delta that doesn't follow on,
+//which can only mean a message was lost on the way
+[[nodiscard]]
+inline bool BroadcastApply(BroadcastState& state, uint32_t& sequence, const uint8_t* bytes, uint32_t length) noexcept
+{
+	if (length < 5)
+		return false;
+
+	uint32_t messageSequence = bytes[1] | (uint32_t)bytes[2] << 8 | (uint32_t)bytes[3] << 16 | (uint32_t)bytes[4] << 24;
+
+	if (bytes[0] == BroadcastSnapshot && length == BroadcastSnapshotBytes)
+	{
+		uint32_t cells = bytes[5] | (uint32_t)bytes[6] << 8 | (uint32_t)bytes[7] << 16;
+		for (int i = 0; i < 9; i++)
+			state.cells[i] = (uint8_t)((cells >> (i * 2)) & 3);
+
+		state.phase = bytes[8] & 3;
+		state.winType = bytes[8] >> 2;
+	}
+	else if (bytes[0] == BroadcastDelta && length == BroadcastDeltaBytes && messageSequence == sequence + 1)
+	{
+		uint8_t cell = bytes[5] & 15;
+		if (cell < 9)
+			state.cells[cell] = bytes[5] >> 4;
+		else if (cell != BroadcastNoCell)
+			return false;
+
+		state.phase = bytes[6] & 3;
+		state.winType = bytes[6] >> 2;
+	}
+	else
+	{
+		return false;
+	}
+
+	sequence = messageSequence;
+	return true;
+}
+
+//what the hub itself holds, not counting the spectators
+[[nodiscard]]
+inline size_t BroadcastMemoryBytes(const BroadcastHub& hub) noexcept
+{
+	return hub.blocks.size() * BroadcastBlockBuffers * sizeof(BroadcastBuffer) + hub.channels.capacity() * sizeof(BroadcastChannel);
+}
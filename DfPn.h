@@ -0,0 +1,465 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//depth-first proof-number search. proves or disproves "the attacker can force a win" from a position,
+//keeping proof and disproof numbers in a fixed-size table so memory never grows with the tree.
+//positions that are rotations or mirrors of each other share one table entry
+
+constexpr uint32_t ProofInfinity = 0x3FFFFFFF;
+constexpr uint32_t ProofMagic = 0x4E504644;
+constexpr uint32_t ProofVersion = 2;
+constexpr int ProofBucketSize = 4;
+
+enum ProofOutcome
+{
+	ProofUnknown,
+	ProofWin,
+	ProofLoss,
+	ProofDraw
+};
+
+struct ProofEntry
+{
+	uint64_t key;
+	uint32_t pn;
+	uint32_t dn;
+	//nodes spent under this entry, the cheapest one in a bucket is the one replaced
+	uint64_t work;
+};
+
+static_assert(sizeof(ProofEntry) == 24);
+
+struct ProofSolver
+{
+	Board board;
+	int symmetryCount = 1;
+	int16_t transforms[8][MaxBoardCells];
+	//the position's hash under every symmetry, one row per ply so undo is free
+	uint64_t symmetryHashes[MaxBoardCells + 1][8];
+
+	std::vector<ProofEntry> entries;
+	uint64_t bucketMask = 0;
+
+	int8_t attacker = PieceNone;
+	uint64_t nodes = 0;
+	uint64_t maxNodes = 0;
+	bool aborted = false;
+
+	const char* checkpointPath = nullptr;
+	uint64_t checkpointInterval = 0;
+	uint64_t nextCheckpoint = 0;
+	int checkpointsWritten = 0;
+};
+
+//tableBytes is rounded down to a power of two number of buckets
+inline void ProofSolverInit(ProofSolver& solver, const Board& position, size_t tableBytes)
+{
+	solver.board = position;
+
+	int width = position.width;
+	int height = position.height;
+	solver.symmetryCount = width == height ? 8 : 4;
+
+	for (int symmetry = 0; symmetry < solver.symmetryCount; symmetry++)
+	{
+		for (int cell = 0; cell < width * height; cell++)
+		{
+			int x = cell % width;
+			int y = cell / width;
+
+			if (symmetry & 1)
+				x = width - 1 - x;
+			if (symmetry & 2)
+				y = height - 1 - y;
+			if (symmetry & 4)
+			{
+				int swap = x;
+				x = y;
+				y = swap;
+			}
+
+			solver.transforms[symmetry][cell] = (int16_t)(y * width + x);
+		}
+	}
+
+	for (int symmetry = 0; symmetry < 8; symmetry++)
+		solver.symmetryHashes[position.moveCount][symmetry] = 0;
+
+	for (int cell = 0; cell < width * height; cell++)
+	{
+		if (position.cells[cell] == PieceNone)
+			continue;
+		for (int symmetry = 0; symmetry < solver.symmetryCount; symmetry++)
+			solver.symmetryHashes[position.moveCount][symmetry] ^= ZobristKey(solver.transforms[symmetry][cell], position.cells[cell]);
+	}
+
+	size_t buckets = 1;
+	while (buckets * 2 * ProofBucketSize * sizeof(ProofEntry) <= tableBytes)
+		buckets *= 2;
+
+	solver.entries.assign(buckets * ProofBucketSize, ProofEntry{});
+	solver.bucketMask = buckets - 1;
+}
+
+inline void ProofPlay(ProofSolver& solver, int cell) noexcept
+{
+	int ply = solver.board.moveCount;
+	int8_t piece = solver.board.toMove;
+	for (int symmetry = 0; symmetry < solver.symmetryCount; symmetry++)
+		solver.symmetryHashes[ply + 1][symmetry] = solver.symmetryHashes[ply][symmetry] ^ ZobristKey(solver.transforms[symmetry][cell], piece);
+	BoardPlay(solver.board, cell);
+}
+
+//smallest hash over all symmetries, and a different key space for each attacker so both proofs can share a table
+[[nodiscard]]
+inline uint64_t ProofKey(const ProofSolver& solver) noexcept
+{
+	const uint64_t* hashes = solver.symmetryHashes[solver.board.moveCount];
+	uint64_t key = hashes[0];
+	for (int symmetry = 1; symmetry < solver.symmetryCount; symmetry++)
+	{
+		if (hashes[symmetry] < key)
+			key = hashes[symmetry];
+	}
+	return (key ^ (solver.attacker == PieceO ? ZobristSideKey : 0)) | 1;
+}
+
+[[nodiscard]]
+inline const ProofEntry* ProofLookup(const ProofSolver& solver, uint64_t key) noexcept
+{
+	const ProofEntry* bucket = &solver.entries[(key & solver.bucketMask) * ProofBucketSize];
+	for (int i = 0; i < ProofBucketSize; i++)
+	{
+		if (bucket[i].key == key)
+			return &bucket[i];
+	}
+	return nullptr;
+}
+
+inline void ProofStore(ProofSolver& solver, uint64_t key, uint32_t pn, uint32_t dn, uint64_t work) noexcept
+{
+	ProofEntry* bucket = &solver.entries[(key & solver.bucketMask) * ProofBucketSize];
+	ProofEntry* victim = &bucket[0];
+	for (int i = 0; i < ProofBucketSize; i++)
+	{
+		if (bucket[i].key == key)
+		{
+			victim = &bucket[i];
+			break;
+		}
+		if (bucket[i].work < victim->work)
+			victim = &bucket[i];
+	}
+
+	*victim = { .key = key, .pn = pn, .dn = dn, .work = work };
+}
+
+[[nodiscard]]
+inline uint32_t ProofAdd(uint32_t a, uint32_t b) noexcept
+{
+	uint64_t sum = (uint64_t)a + b;
+	return sum >= ProofInfinity ? ProofInfinity : (uint32_t)sum;
+}
+
+//not cryptographic, just cheap enough to run over the whole table and sensitive to any changed bit
+[[nodiscard]]
+inline uint64_t ProofHash(uint64_t hash, const uint64_t* words, size_t count) noexcept
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDull;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+//of the header in front of it and every entry, an entry is 3 words with no padding
+[[nodiscard]]
+inline uint64_t ProofCheckpointHash(const uint64_t* header, const std::vector<ProofEntry>& entries) noexcept
+{
+	uint64_t hash = ProofHash(0x9E3779B97F4A7C15ull, header, 6);
+	return ProofHash(hash, (const uint64_t*)entries.data(), entries.size() * 3);
+}
+
+//the table is the whole state of a solve, so a checkpoint is just the table behind a header describing the root
+[[nodiscard]]
+inline bool ProofSaveCheckpoint(const ProofSolver& solver, const char* path) noexcept
+{
+	char temporaryPath[1040];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+
+	FILE* file = fopen(temporaryPath, "wb");
+	if (file == nullptr)
+		return false;
+
+	uint64_t header[7] =
+	{
+		((uint64_t)ProofVersion << 32) | ProofMagic,
+		((uint64_t)solver.board.width << 32) | (uint64_t)solver.board.height,
+		(uint64_t)solver.board.winLength,
+		solver.symmetryHashes[solver.board.moveCount][0],
+		(uint64_t)solver.entries.size(),
+		solver.nodes,
+		0
+	};
+	header[6] = ProofCheckpointHash(header, solver.entries);
+
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1 &&
+		fwrite(solver.entries.data(), sizeof(ProofEntry), solver.entries.size(), file) == solver.entries.size();
+
+	ok = fclose(file) == 0 && ok;
+
+	//replace the old checkpoint only once the new one is complete
+	if (ok)
+	{
+		remove(path);
+		ok = rename(temporaryPath, path) == 0;
+	}
+
+	return ok;
+}
+
+[[nodiscard]]
+inline bool ProofReadCheckpoint(ProofSolver& solver, const char* path) noexcept
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	uint64_t header[7];
+	bool ok = fread(header, sizeof(header), 1, file) == 1 &&
+		header[0] == (((uint64_t)ProofVersion << 32) | ProofMagic) &&
+		header[1] == (((uint64_t)solver.board.width << 32) | (uint64_t)solver.board.height) &&
+		header[2] == (uint64_t)solver.board.winLength &&
+		header[3] == solver.symmetryHashes[solver.board.moveCount][0] &&
+		header[4] == (uint64_t)solver.entries.size() &&
+		fread(solver.entries.data(), sizeof(ProofEntry), solver.entries.size(), file) == solver.entries.size() &&
+		fgetc(file) == EOF &&
+		header[6] == ProofCheckpointHash(header, solver.entries);
+
+	fclose(file);
+
+	if (ok)
+		solver.nodes = header[5];
+
+	return ok;
+}
+
+//only loads a checkpoint written for the same root position and table size, and only if every entry is as it was written
+[[nodiscard]]
+inline bool ProofLoadCheckpoint(ProofSolver& solver, const char* path) noexcept
+{
+	//a crash between removing the old checkpoint and renaming the new one leaves only the new one
+	char temporaryPath[1040];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+
+	if (ProofReadCheckpoint(solver, path) || ProofReadCheckpoint(solver, temporaryPath))
+		return true;
+
+	for (ProofEntry& entry : solver.entries)
+		entry = ProofEntry{};
+
+	return false;
+}
+
+//expands the current position until its proof number reaches thresholdPn or its disproof number reaches thresholdDn
+inline void ProofMid(ProofSolver& solver, uint32_t thresholdPn, uint32_t thresholdDn, uint32_t& pn, uint32_t& dn) noexcept
+{
+	Board& board = solver.board;
+	bool orNode = board.toMove == solver.attacker;
+	uint64_t startNodes = solver.nodes++;
+
+	int16_t childCells[MaxBoardCells];
+	uint32_t childPn[MaxBoardCells];
+	uint32_t childDn[MaxBoardCells];
+	int childCount = 0;
+
+	//if the opponent threatens to win next move, only the blocks are worth looking at
+	int16_t blocks[MaxBoardCells];
+	int blockCount = 0;
+	int8_t opponent = OtherPiece(board.toMove);
+
+	for (int cell = 0; cell < BoardCellCount(board); cell++)
+	{
+		if (board.cells[cell] != PieceNone)
+			continue;
+
+		board.cells[cell] = opponent;
+		if (BoardIsWinningMove(board, cell))
+			blocks[blockCount++] = (int16_t)cell;
+		board.cells[cell] = PieceNone;
+	}
+
+	for (int cell = 0; cell < BoardCellCount(board); cell++)
+	{
+		if (board.cells[cell] != PieceNone)
+			continue;
+
+		if (blockCount != 0)
+		{
+			bool isBlock = false;
+			for (int i = 0; i < blockCount && !isBlock; i++)
+				isBlock = blocks[i] == cell;
+
+			//a winning move beats blocking, so those are kept as well
+			board.cells[cell] = board.toMove;
+			bool wins = BoardIsWinningMove(board, cell);
+			board.cells[cell] = PieceNone;
+
+			if (!isBlock && !wins)
+				continue;
+		}
+
+		ProofPlay(solver, cell);
+
+		uint32_t cpn = 1;
+		uint32_t cdn = 1;
+
+		if (BoardIsWinningMove(board, cell))
+		{
+			//whoever just moved won
+			bool attackerWon = board.toMove != solver.attacker;
+			cpn = attackerWon ? 0 : ProofInfinity;
+			cdn = attackerWon ? ProofInfinity : 0;
+		}
+		else if (BoardIsFull(board))
+		{
+			cpn = ProofInfinity;
+			cdn = 0;
+		}
+		else if (const ProofEntry* entry = ProofLookup(solver, ProofKey(solver)))
+		{
+			cpn = entry->pn;
+			cdn = entry->dn;
+		}
+
+		BoardUndo(board);
+
+		childCells[childCount] = (int16_t)cell;
+		childPn[childCount] = cpn;
+		childDn[childCount] = cdn;
+		childCount++;
+	}
+
+	while (true)
+	{
+		//OR node: proven by any child, disproven by all. AND node the other way round
+		const uint32_t* minimised = orNode ? childPn : childDn;
+		const uint32_t* summed = orNode ? childDn : childPn;
+
+		uint32_t best = ProofInfinity;
+		uint32_t second = ProofInfinity;
+		uint32_t sum = 0;
+		int bestChild = -1;
+
+		for (int i = 0; i < childCount; i++)
+		{
+			sum = ProofAdd(sum, summed[i]);
+			if (minimised[i] < best)
+			{
+				second = best;
+				best = minimised[i];
+				bestChild = i;
+			}
+			else if (minimised[i] < second)
+			{
+				second = minimised[i];
+			}
+		}
+
+		pn = orNode ? best : sum;
+		dn = orNode ? sum : best;
+
+		if (pn >= thresholdPn || dn >= thresholdDn || pn == 0 || dn == 0 || bestChild < 0)
+			break;
+
+		if (solver.maxNodes != 0 && solver.nodes >= solver.maxNodes)
+		{
+			solver.aborted = true;
+			break;
+		}
+
+		if (solver.checkpointPath != nullptr && solver.nodes >= solver.nextCheckpoint)
+		{
+			solver.nextCheckpoint = solver.nodes + solver.checkpointInterval;
+			if (ProofSaveCheckpoint(solver, solver.checkpointPath))
+				solver.checkpointsWritten++;
+		}
+
+		//thresholds for the chosen child, with a 1/4 margin over the runner-up so the search doesn't flip between siblings
+		uint64_t margin = (uint64_t)second + second / 4 + 1;
+		uint32_t minimisedThreshold = (uint32_t)(margin < (orNode ? thresholdPn : thresholdDn) ? margin : (orNode ? thresholdPn : thresholdDn));
+		uint32_t summedThreshold = ProofAdd(summed[bestChild], (orNode ? thresholdDn : thresholdPn) - (orNode ? dn : pn));
+
+		uint32_t newPn;
+		uint32_t newDn;
+
+		ProofPlay(solver, childCells[bestChild]);
+		ProofMid(solver,
+			orNode ? minimisedThreshold : summedThreshold,
+			orNode ? summedThreshold : minimisedThreshold,
+			newPn,
+			newDn);
+		BoardUndo(board);
+
+		childPn[bestChild] = newPn;
+		childDn[bestChild] = newDn;
+
+		if (solver.aborted)
+			break;
+	}
+
+	ProofStore(solver, ProofKey(solver), pn, dn, solver.nodes - startNodes);
+}
+
+//true if proven, false if disproven or the node limit ran out (check solver.aborted)
+inline bool ProofSolve(ProofSolver& solver, int8_t attacker) noexcept
+{
+	solver.attacker = attacker;
+	solver.aborted = false;
+	solver.nextCheckpoint = solver.nodes + solver.checkpointInterval;
+
+	uint32_t pn = 1;
+	uint32_t dn = 1;
+
+	while (pn != 0 && dn != 0 && !solver.aborted)
+		ProofMid(solver, ProofInfinity, ProofInfinity, pn, dn);
+
+	return pn == 0;
+}
+
+//win, loss or draw for the side to move: first try to prove it wins, then that the other side does
+[[nodiscard]]
+inline ProofOutcome ProofClassify(ProofSolver& solver) noexcept
+{
+	if (BoardLastMoveWon(solver.board))
+		return ProofLoss;
+	if (BoardIsFull(solver.board))
+		return ProofDraw;
+
+	int8_t side = solver.board.toMove;
+
+	if (ProofSolve(solver, side))
+		return ProofWin;
+	if (solver.aborted)
+		return ProofUnknown;
+
+	if (ProofSolve(solver, OtherPiece(side)))
+		return ProofLoss;
+	if (solver.aborted)
+		return ProofUnknown;
+
+	return ProofDraw;
+}
@@ -0,0 +1,263 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+#include "Search.h"
+#include "Renderer.h"
+#include "InputQueue.h"
+
+#include <cstdint>
+
+//the rules of one game against the CPU, from the menu to the scores, driven by input events and a clock.
+//nothing here knows about the window, so a recorded session plays back the same anywhere
+
+constexpr int64_t CPUThinkingNs = 1'000'000'000;
+constexpr int64_t GameFinishedNs = 3'000'000'000;
+
+struct GameSession;
+
+//picks the CPU's reply right after the player moves
+using ReplyChooser = int(*)(GameSession& session, void* context) noexcept;
+
+//told about every finished game, winner is 2 for the player, 1 for the CPU and 0 for a tie
+using ResultRecorder = void(*)(GameSession& session, int winner, int winType, void* context) noexcept;
+
+struct GameSession
+{
+	//0 menu, 1 player's turn, 2 CPU's turn, 3 game over
+	int gameState = 0;
+	char boardState[9];
+	int winType = 0;
+	int64_t playerScore = 0;
+	int64_t CPUScore = 0;
+	int CPUMoveCount = 0;
+
+	//mirrors boardState in move order for the CPU's search
+	Board board;
+	int CPUReply = -1;
+	int64_t timerFinishedNs = 0;
+
+	//where the last move event left the cursor, over nothing until the first one
+	float cursorX = -1;
+	float cursorY = -1;
+
+	//replaces rand() so a replayed session picks the same replies
+	uint64_t random = 0;
+
+	ReplyChooser chooseReply = nullptr;
+	void* replyContext = nullptr;
+
+	ResultRecorder onResult = nullptr;
+	void* resultContext = nullptr;
+
+	bool exitRequested = false;
+};
+
+inline void GameClearBoard(GameSession& session) noexcept
+{
+	//distinct negative values so that no three empty squares ever count as a line
+	for (int i = 0; i < 9; i++)
+		session.boardState[i] = (char)(-1 - i);
+
+	BoardInit(session.board, 3, 3, 3);
+	session.CPUMoveCount = 0;
+}
+
+inline void GameSessionInit(GameSession& session, uint64_t seed) noexcept
+{
+	session = GameSession{};
+	session.random = seed;
+	GameClearBoard(session);
+}
+
+[[nodiscard]]
+inline SearchLimits GameSearchLimits(GameSession& session) noexcept
+{
+	return SearchLimits{ .seed = (uint32_t)SplitMix64(session.random) | 1, .threatNodes = 4096 };
+}
+
+[[nodiscard]]
+inline int GameCheckForWinner(const char* boardState) noexcept
+{
+	//horizontal
+	if (boardState[0] == boardState[1] && boardState[1] == boardState[2])
+		return 1;
+
+	if (boardState[3] == boardState[4] && boardState[4] == boardState[5])
+		return 2;
+
+	if (boardState[6] == boardState[7] && boardState[7] == boardState[8])
+		return 3;
+
+	//vertical
+	if (boardState[0] == boardState[3] && boardState[3] == boardState[6])
+		return 4;
+
+	if (boardState[1] == boardState[4] && boardState[4] == boardState[7])
+		return 5;
+
+	if (boardState[2] == boardState[5] && boardState[5] == boardState[8])
+		return 6;
+
+	//diagonal
+	if (boardState[0] == boardState[4] && boardState[4] == boardState[8])
+		return 7;
+
+	if (boardState[6] == boardState[4] && boardState[4] == boardState[2])
+		return 8;
+
+	return 0;
+}
+
+inline void GameReportResult(GameSession& session, int winner) noexcept
+{
+	if (session.onResult != nullptr)
+		session.onResult(session, winner, session.winType, session.resultContext);
+}
+
+inline void GamePlayerMove(GameSession& session, int square, int64_t nowNs) noexcept
+{
+	session.boardState[square] = 2;
+	BoardPlay(session.board, square);
+
+	session.CPUReply = session.chooseReply != nullptr
+		? session.chooseReply(session, session.replyContext)
+		: SearchBestMove(session.board, GameSearchLimits(session)).bestMove;
+
+	session.winType = GameCheckForWinner(session.boardState);
+
+	if (session.winType != 0)
+	{
+		session.playerScore++;
+		session.gameState = 3;
+		session.timerFinishedNs = nowNs + GameFinishedNs;
+		GameReportResult(session, 2);
+	}
+	else
+	{
+		session.gameState = 2;
+		session.timerFinishedNs = nowNs + CPUThinkingNs;
+	}
+}
+
+//applies one event, nowNs is the time of the frame handling it
+inline void GameHandleInput(GameSession& session, const SceneLayout& layout, const InputEvent& event, int64_t nowNs) noexcept
+{
+	if (event.kind == InputKey)
+	{
+		//back to the menu, the scores are kept since they're the player's running totals
+		if (event.key == InputKeyEscape)
+		{
+			session.gameState = 0;
+			GameClearBoard(session);
+		}
+		return;
+	}
+
+	session.cursorX = event.x;
+	session.cursorY = event.y;
+
+	if (event.kind != InputClick)
+		return;
+
+	if (session.gameState == 0)
+	{
+		MenuButton button = MenuHitTest(layout, event.x, event.y);
+		if (button == MenuButtonPlay)
+			session.gameState = 1;
+		else if (button == MenuButtonExit)
+			session.exitRequested = true;
+	}
+	else if (session.gameState == 1)
+	{
+		int square = BoardHitTest(layout, event.x, event.y);
+		if (square != 9 && session.boardState[square] < 0)
+			GamePlayerMove(session, square, nowNs);
+	}
+}
+
+//moves the game on once the CPU has finished "thinking" or the finished board has been up long enough
+inline void GameAdvance(GameSession& session, int64_t nowNs) noexcept
+{
+	if (session.gameState == 2)
+	{
+		if (session.CPUMoveCount == 4)
+		{
+			//tie, the board clears when the CPU would have moved
+			session.gameState = 3;
+			GameReportResult(session, 0);
+		}
+		else if (nowNs > session.timerFinishedNs)
+		{
+			session.boardState[session.CPUReply] = 1;
+			BoardPlay(session.board, session.CPUReply);
+
+			session.CPUMoveCount++;
+
+			session.winType = GameCheckForWinner(session.boardState);
+
+			if (session.winType != 0)
+			{
+				session.CPUScore++;
+				session.gameState = 3;
+				session.timerFinishedNs = nowNs + GameFinishedNs;
+				GameReportResult(session, 1);
+			}
+			else
+			{
+				session.gameState = 1;
+			}
+		}
+	}
+	else if (session.gameState == 3)
+	{
+		if (nowNs > session.timerFinishedNs)
+		{
+			GameClearBoard(session);
+			session.gameState = 1;
+		}
+	}
+}
+
+constexpr int64_t GameNoDeadlineNs = INT64_MAX;
+
+//when GameAdvance next has anything to do, GameNoDeadlineNs while the game waits on the player or sits in the menu.
+//a host running many sessions keeps one timer per session at this time instead of calling GameAdvance on all of them every frame
+[[nodiscard]]
+inline int64_t GameNextDeadlineNs(const GameSession& session) noexcept
+{
+	//a tie is called on the first advance after the player's last move
+	if (session.gameState == 2 && session.CPUMoveCount == 4)
+		return 0;
+
+	if (session.gameState == 2 || session.gameState == 3)
+		return session.timerFinishedNs + 1;
+
+	return GameNoDeadlineNs;
+}
+
+[[nodiscard]]
+inline MenuButton GameMenuHover(const GameSession& session, const SceneLayout& layout) noexcept
+{
+	return MenuHitTest(layout, session.cursorX, session.cursorY);
+}
+
+[[nodiscard]]
+inline GameFrame GameFrameFor(const GameSession& session, const SceneLayout& layout) noexcept
+{
+	int hover = BoardHitTest(layout, session.cursorX, session.cursorY);
+
+	return GameFrame
+	{
+		.boardState = session.boardState,
+		.ghostSquare = session.gameState == 1 && hover != 9 && session.boardState[hover] < 0 ? hover : 9,
+		.winType = session.gameState == 3 ? session.winType : 0,
+		.playerScore = session.playerScore,
+		.CPUScore = session.CPUScore
+	};
+}
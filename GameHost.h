@@ -0,0 +1,136 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Game.h"
+#include "InputQueue.h"
+#include "Ponder.h"
+#include "Renderer.h"
+#include "Search.h"
+#include "TimerWheel.h"
+
+#include <cstdint>
+#include <vector>
+
+//everything the window keeps between frames apart from what it draws with, and the frame itself.
+//the window, the frame allocation check and the replay all run GameHostFrame, so what's checked is what ships
+
+struct GameHost
+{
+	GameSession game;
+
+	//wakes the game when the CPU is done "thinking" or the finished board has been up long enough, in place of checking every frame
+	TimerWheel timers;
+	TimerHandle timer = 0;
+	int64_t timerDeadlineNs = GameNoDeadlineNs;
+	std::vector<TimerExpiry> expired;
+
+	//the CPU's own table, when it's left empty the CPU searches without one
+	TranspositionTable CPUTable;
+
+	//searches the CPU's replies while the player is still picking a square
+	Ponderer ponderer;
+	//off for replays, where whether the ponder search finished before the player moved would depend on the machine
+	bool ponder = true;
+
+	//filled as input arrives, emptied once per frame
+	InputQueue input;
+
+	//arrival times of the events handled this frame, waiting for the frame to be presented
+	int64_t eventTimes[InputQueueCapacity];
+
+	SceneLayout layout;
+	LayerCache layerCache;
+};
+
+[[nodiscard]]
+inline int GameHostChooseReply(GameSession& session, void* context) noexcept
+{
+	GameHost& host = *(GameHost*)context;
+
+	int reply;
+	if (!PonderProbe(host.ponderer, session.board, reply))
+	{
+		PonderCancel(host.ponderer);
+		reply = SearchBestMove(session.board, GameSearchLimits(session), TTSize(host.CPUTable) != 0 ? &host.CPUTable : nullptr).bestMove;
+	}
+	PonderCancel(host.ponderer);
+	return reply;
+}
+
+//sizes everything the frames use and starts the ponder worker, nothing after this allocates once the first turns are played
+inline void GameHostInit(GameHost& host, uint64_t seed, int64_t nowNs, size_t ponderTableEntries = 1 << 12)
+{
+	GameSessionInit(host.game, seed);
+	host.game.chooseReply = GameHostChooseReply;
+	host.game.replyContext = &host;
+
+	TimerWheelInit(host.timers, nowNs, 20, 4);
+	host.timer = 0;
+	host.timerDeadlineNs = GameNoDeadlineNs;
+	host.expired.reserve(4);
+
+	PonderInit(host.ponderer, ponderTableEntries);
+}
+
+inline void GameHostScheduleTimer(GameHost& host) noexcept
+{
+	int64_t deadlineNs = GameNextDeadlineNs(host.game);
+	if (deadlineNs == host.timerDeadlineNs)
+		return;
+
+	TimerWheelCancel(host.timers, host.timer);
+	host.timer = deadlineNs == GameNoDeadlineNs ? 0 : TimerWheelInsert(host.timers, deadlineNs, 0);
+	host.timerDeadlineNs = deadlineNs;
+}
+
+//one frame: the input that arrived since the last one, the game's timer, pondering and drawing.
+//returns how many events were handled, with their arrival times in eventTimes. nothing is drawn once the game asks to exit
+inline int GameHostFrame(GameHost& host, RenderBackend& backend, int64_t nowNs) noexcept
+{
+	GameSession& game = host.game;
+
+	int handled = 0;
+	InputEvent event;
+	while (InputPop(host.input, event))
+	{
+		GameHandleInput(game, host.layout, event, nowNs);
+		if (handled < (int)InputQueueCapacity)
+			host.eventTimes[handled++] = event.timeNs;
+
+		//escape can't leave a search running on a board that no longer exists
+		if (game.gameState == 0)
+			PonderCancel(host.ponderer);
+	}
+
+	if (game.exitRequested)
+		return handled;
+
+	if (game.gameState == 0)
+	{
+		RenderMenu(backend, host.layerCache, host.layout, GameMenuHover(game, host.layout));
+		return handled;
+	}
+
+	GameHostScheduleTimer(host);
+	TimerWheelAdvance(host.timers, nowNs, host.expired);
+
+	if (!host.expired.empty())
+	{
+		host.timer = 0;
+		host.timerDeadlineNs = GameNoDeadlineNs;
+
+		GameAdvance(game, nowNs);
+		GameHostScheduleTimer(host);
+	}
+
+	if (host.ponder && game.gameState == 1 && !host.ponderer.active)
+		PonderStart(host.ponderer, game.board, GameSearchLimits(game));
+
+	RenderGame(backend, host.layerCache, host.layout, GameFrameFor(game, host.layout));
+	return handled;
+}
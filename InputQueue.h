@@ -0,0 +1,178 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+
+//mouse and keyboard input, timestamped where the window receives it and drained once per frame by the game logic.
+//one thread pushes and one thread pops, neither ever waits on the other
+
+enum InputKind : uint8_t
+{
+	InputMove,
+	InputClick,
+	InputKey
+};
+
+constexpr uint32_t InputKeyEscape = 0x1B;
+
+struct InputEvent
+{
+	//steady clock, the same one frames are timed with
+	int64_t timeNs;
+	float x;
+	float y;
+	uint32_t key;
+	InputKind kind;
+};
+
+constexpr uint32_t InputQueueCapacity = 1024;
+
+static_assert((InputQueueCapacity & (InputQueueCapacity - 1)) == 0, "capacity must be a power of two");
+
+struct InputQueue
+{
+	//each side keeps its own copy of the other side's index and only rereads it when the queue looks full or empty,
+	//so the shared cache lines only move when they have to
+	alignas(64) std::atomic<uint32_t> head = 0;
+	uint32_t cachedTail = 0;
+
+	alignas(64) std::atomic<uint32_t> tail = 0;
+	uint32_t cachedHead = 0;
+	//producer only, events thrown away because the consumer fell a whole queue behind
+	uint64_t dropped = 0;
+
+	alignas(64) InputEvent events[InputQueueCapacity];
+};
+
+//producer side, false when the queue is full
+inline bool InputPush(InputQueue& queue, const InputEvent& event) noexcept
+{
+	uint32_t tail = queue.tail.load(std::memory_order_relaxed);
+
+	if (tail - queue.cachedHead == InputQueueCapacity)
+	{
+		queue.cachedHead = queue.head.load(std::memory_order_acquire);
+		if (tail - queue.cachedHead == InputQueueCapacity)
+		{
+			queue.dropped++;
+			return false;
+		}
+	}
+
+	queue.events[tail & (InputQueueCapacity - 1)] = event;
+	queue.tail.store(tail + 1, std::memory_order_release);
+	return true;
+}
+
+//consumer side, false when the queue is empty
+[[nodiscard]]
+inline bool InputPop(InputQueue& queue, InputEvent& event) noexcept
+{
+	uint32_t head = queue.head.load(std::memory_order_relaxed);
+
+	if (head == queue.cachedTail)
+	{
+		queue.cachedTail = queue.tail.load(std::memory_order_acquire);
+		if (head == queue.cachedTail)
+			return false;
+	}
+
+	event = queue.events[head & (InputQueueCapacity - 1)];
+	queue.head.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+//how long events waited between arriving and the frame that showed their effect being presented.
+//eight buckets per power of two, so a percentile is never more than 12.5% off and recording never allocates
+constexpr int InputLatencySubBuckets = 8;
+constexpr int InputLatencyBuckets = 64 * InputLatencySubBuckets;
+
+struct InputLatencyStats
+{
+	uint64_t counts[InputLatencyBuckets] = {};
+	uint64_t samples = 0;
+	int64_t totalNs = 0;
+	int64_t maxNs = 0;
+};
+
+[[nodiscard]]
+constexpr int InputLatencyBucket(uint64_t ns) noexcept
+{
+	if (ns < InputLatencySubBuckets)
+		return (int)ns;
+
+	int octave = 63 - std::countl_zero(ns);
+	int fraction = (int)(ns >> (octave - 3)) & (InputLatencySubBuckets - 1);
+	return (octave - 2) * InputLatencySubBuckets + fraction;
+}
+
+//the largest latency that lands in the bucket
+[[nodiscard]]
+constexpr int64_t InputLatencyBucketLimit(int bucket) noexcept
+{
+	if (bucket < InputLatencySubBuckets)
+		return bucket;
+
+	int octave = bucket / InputLatencySubBuckets + 2;
+	int fraction = bucket % InputLatencySubBuckets;
+	return (int64_t)(((uint64_t)(InputLatencySubBuckets + fraction + 1) << (octave - 3)) - 1);
+}
+
+inline void InputLatencyRecord(InputLatencyStats& stats, int64_t latencyNs) noexcept
+{
+	if (latencyNs < 0)
+		latencyNs = 0;
+
+	stats.counts[InputLatencyBucket((uint64_t)latencyNs)]++;
+	stats.samples++;
+	stats.totalNs += latencyNs;
+	if (latencyNs > stats.maxNs)
+		stats.maxNs = latencyNs;
+}
+
+//percentile between 0 and 1
+[[nodiscard]]
+inline int64_t InputLatencyPercentile(const InputLatencyStats& stats, double percentile) noexcept
+{
+	if (stats.samples == 0)
+		return 0;
+
+	uint64_t rank = (uint64_t)(percentile * (stats.samples - 1));
+	uint64_t seen = 0;
+
+	for (int bucket = 0; bucket < InputLatencyBuckets; bucket++)
+	{
+		seen += stats.counts[bucket];
+		if (seen > rank)
+			return InputLatencyBucketLimit(bucket) < stats.maxNs ? InputLatencyBucketLimit(bucket) : stats.maxNs;
+	}
+
+	return stats.maxNs;
+}
+
+//traces are one event per line: time kind x y key, times relative to the first event
+inline void InputTraceWrite(FILE* file, const InputEvent& event, int64_t startNs) noexcept
+{
+	fprintf(file, "%lld %d %.1f %.1f %u\n", (long long)(event.timeNs - startNs), (int)event.kind, event.x, event.y, event.key);
+}
+
+[[nodiscard]]
+inline bool InputTraceRead(FILE* file, InputEvent& event) noexcept
+{
+	long long timeNs;
+	int kind;
+	if (fscanf(file, "%lld %d %f %f %u", &timeNs, &kind, &event.x, &event.y, &event.key) != 5 || kind < InputMove || kind > InputKey)
+		return false;
+
+	event.timeNs = timeNs;
+	event.kind = (InputKind)kind;
+	return true;
+}
@@ -0,0 +1,405 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+#include "Search.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+//n-tuple value function: every straight window of the board indexes a table of weights by the pattern of stones in it,
+//windows that are the same under a rotation or mirror of the board share one table
+
+constexpr uint32_t NTupleMagic = 0x4C50544E;
+constexpr uint32_t NTupleVersion = 1;
+constexpr int MaxTupleLength = 6;
+
+struct NTupleWindowRef
+{
+	int32_t window;
+	int32_t power;
+};
+
+struct NTupleNetwork
+{
+	int width = 0;
+	int height = 0;
+	int winLength = 0;
+	int tupleLength = 0;
+	int windowCount = 0;
+	int tableCount = 0;
+	int tableSize = 0;
+	//windowCount * tupleLength cells, each window listed in the digit order of its table
+	std::vector<int16_t> windowCells;
+	std::vector<int32_t> windowOffsets;
+	//every window through a cell along with the 3^digit that cell contributes to it
+	std::vector<NTupleWindowRef> cellWindows;
+	std::vector<int32_t> cellWindowStart;
+	//trainer threads add to these without locking, a lost update now and then doesn't matter to TD learning
+	std::vector<std::atomic<float>> weights;
+};
+
+[[nodiscard]]
+inline int NTupleTransform(int cell, int symmetry, int width, int height) noexcept
+{
+	int x = cell % width;
+	int y = cell / width;
+
+	if (symmetry & 1)
+		x = width - 1 - x;
+	if (symmetry & 2)
+		y = height - 1 - y;
+	if (symmetry & 4)
+	{
+		int swap = x;
+		x = y;
+		y = swap;
+	}
+
+	return y * width + x;
+}
+
+inline void NTupleInit(NTupleNetwork& network, int width, int height, int winLength)
+{
+	network.width = width;
+	network.height = height;
+	network.winLength = winLength;
+	network.tupleLength = winLength < MaxTupleLength ? winLength : MaxTupleLength;
+	network.tableSize = 1;
+	for (int i = 0; i < network.tupleLength; i++)
+		network.tableSize *= 3;
+
+	int length = network.tupleLength;
+
+	std::vector<int16_t> cells;
+	std::unordered_map<int, int> windowByEnds;
+
+	for (const auto& direction : BoardDirections)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			int endY = y + direction[1] * (length - 1);
+			if (endY < 0 || endY >= height)
+				continue;
+
+			for (int x = 0; x + direction[0] * (length - 1) < width; x++)
+			{
+				int first = y * width + x;
+				int last = endY * width + x + direction[0] * (length - 1);
+				windowByEnds[first < last ? first * MaxBoardCells + last : last * MaxBoardCells + first] = (int)(cells.size() / length);
+
+				for (int i = 0; i < length; i++)
+					cells.push_back((int16_t)((y + direction[1] * i) * width + x + direction[0] * i));
+			}
+		}
+	}
+
+	network.windowCount = (int)(cells.size() / length);
+	network.windowCells.resize(cells.size());
+	network.windowOffsets.resize(network.windowCount);
+
+	int symmetryCount = width == height ? 8 : 4;
+	std::vector<int> tableOfRepresentative(network.windowCount, -1);
+	network.tableCount = 0;
+
+	for (int window = 0; window < network.windowCount; window++)
+	{
+		const int16_t* windowCells = &cells[window * length];
+
+		//the lowest numbered window in the orbit owns the table
+		int representative = window;
+		int representativeSymmetry = 0;
+		for (int symmetry = 1; symmetry < symmetryCount; symmetry++)
+		{
+			int first = NTupleTransform(windowCells[0], symmetry, width, height);
+			int last = NTupleTransform(windowCells[length - 1], symmetry, width, height);
+			int image = windowByEnds[first < last ? first * MaxBoardCells + last : last * MaxBoardCells + first];
+			if (image < representative)
+			{
+				representative = image;
+				representativeSymmetry = symmetry;
+			}
+		}
+
+		if (tableOfRepresentative[representative] < 0)
+			tableOfRepresentative[representative] = network.tableCount++;
+
+		network.windowOffsets[window] = tableOfRepresentative[representative] * network.tableSize;
+
+		//put the cells in the order their images appear in the representative so the digits line up
+		const int16_t* representativeCells = &cells[representative * length];
+		for (int i = 0; i < length; i++)
+		{
+			int image = NTupleTransform(windowCells[i], representativeSymmetry, width, height);
+			for (int j = 0; j < length; j++)
+			{
+				if (representativeCells[j] == image)
+				{
+					network.windowCells[window * length + j] = windowCells[i];
+					break;
+				}
+			}
+		}
+	}
+
+	int cellCount = width * height;
+	network.cellWindowStart.assign(cellCount + 1, 0);
+	for (int16_t cell : network.windowCells)
+		network.cellWindowStart[cell + 1]++;
+	for (int cell = 0; cell < cellCount; cell++)
+		network.cellWindowStart[cell + 1] += network.cellWindowStart[cell];
+
+	network.cellWindows.resize(network.windowCells.size());
+	std::vector<int32_t> fill(network.cellWindowStart.begin(), network.cellWindowStart.end() - 1);
+	for (int window = 0; window < network.windowCount; window++)
+	{
+		int power = 1;
+		for (int j = 0; j < length; j++)
+		{
+			network.cellWindows[fill[network.windowCells[window * length + j]]++] = { window, power };
+			power *= 3;
+		}
+	}
+
+	network.weights = std::vector<std::atomic<float>>(network.tableCount * network.tableSize);
+}
+
+//digits are 0 for empty, 1 for the given side and 2 for the other side
+[[nodiscard]]
+inline int32_t NTuplePattern(const NTupleNetwork& network, const Board& board, int window, int8_t side) noexcept
+{
+	//indexed by piece, a table instead of comparisons keeps this loop free of branches
+	static constexpr int32_t Digits[3][3] = { { 0, 0, 0 }, { 0, 1, 2 }, { 0, 2, 1 } };
+	const int32_t* digits = Digits[side];
+	const int16_t* cells = &network.windowCells[window * network.tupleLength];
+	int32_t pattern = 0;
+
+	for (int j = network.tupleLength - 1; j >= 0; j--)
+		pattern = pattern * 3 + digits[board.cells[cells[j]]];
+
+	return pattern;
+}
+
+[[nodiscard]]
+inline float NTupleWeight(const NTupleNetwork& network, int32_t index) noexcept
+{
+	return network.weights[index].load(std::memory_order_relaxed);
+}
+
+//raw sum of the weights, positive when the position is good for side
+[[nodiscard]]
+inline float NTupleSum(const NTupleNetwork& network, const Board& board, int8_t side) noexcept
+{
+	float sum = 0.0f;
+	for (int window = 0; window < network.windowCount; window++)
+		sum += NTupleWeight(network, network.windowOffsets[window] + NTuplePattern(network, board, window, side));
+	return sum;
+}
+
+//change in NTupleSum(board, side) if side were to play the empty cell
+[[nodiscard]]
+inline float NTupleMoveDelta(const NTupleNetwork& network, const Board& board, int cell, int8_t side) noexcept
+{
+	float delta = 0.0f;
+	for (int32_t i = network.cellWindowStart[cell]; i < network.cellWindowStart[cell + 1]; i++)
+	{
+		const NTupleWindowRef& ref = network.cellWindows[i];
+		int32_t index = network.windowOffsets[ref.window] + NTuplePattern(network, board, ref.window, side);
+		delta += NTupleWeight(network, index + ref.power) - NTupleWeight(network, index);
+	}
+	return delta;
+}
+
+[[nodiscard]]
+inline bool NTupleSave(const NTupleNetwork& network, const char* path) noexcept
+{
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr)
+		return false;
+
+	uint32_t header[8] =
+	{
+		NTupleMagic,
+		NTupleVersion,
+		(uint32_t)network.width,
+		(uint32_t)network.height,
+		(uint32_t)network.winLength,
+		(uint32_t)network.tupleLength,
+		(uint32_t)network.tableCount,
+		(uint32_t)network.tableSize
+	};
+
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+
+	float buffer[1024];
+	size_t total = network.weights.size();
+	for (size_t i = 0; ok && i < total; i += 1024)
+	{
+		size_t count = total - i < 1024 ? total - i : 1024;
+		for (size_t j = 0; j < count; j++)
+			buffer[j] = network.weights[i + j].load(std::memory_order_relaxed);
+		ok = fwrite(buffer, sizeof(float), count, file) == count;
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+//fails if the file is missing, damaged, or was trained on a different board
+[[nodiscard]]
+inline bool NTupleLoad(NTupleNetwork& network, const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	uint32_t header[8];
+	if (fread(header, sizeof(header), 1, file) != 1 ||
+		header[0] != NTupleMagic ||
+		header[1] != NTupleVersion ||
+		header[2] < 1 || header[2] > MaxBoardWidth ||
+		header[3] < 1 || header[3] > MaxBoardWidth ||
+		header[4] < 1)
+	{
+		fclose(file);
+		return false;
+	}
+
+	NTupleInit(network, (int)header[2], (int)header[3], (int)header[4]);
+
+	if (header[5] != (uint32_t)network.tupleLength || header[6] != (uint32_t)network.tableCount || header[7] != (uint32_t)network.tableSize)
+	{
+		fclose(file);
+		return false;
+	}
+
+	float buffer[1024];
+	size_t total = network.weights.size();
+	bool ok = true;
+	for (size_t i = 0; ok && i < total; i += 1024)
+	{
+		size_t count = total - i < 1024 ? total - i : 1024;
+		ok = fread(buffer, sizeof(float), count, file) == count;
+		for (size_t j = 0; ok && j < count; j++)
+			network.weights[i + j].store(buffer[j], std::memory_order_relaxed);
+	}
+
+	fclose(file);
+	return ok;
+}
+
+//the network Search uses when SearchLimits::evaluate is EvaluateNTuple
+inline const NTupleNetwork* ActiveNetwork = nullptr;
+
+//the weights score the position for whoever just moved, so flip it for the side to move
+[[nodiscard]]
+inline int EvaluateNTuple(const Board& board) noexcept
+{
+	float value = std::tanh(NTupleSum(*ActiveNetwork, board, OtherPiece(board.toMove)));
+	return -(int)(value * (DecisiveScore / 2));
+}
+
+struct NTupleTrainer
+{
+	float learningRate = 0.01f;
+	float exploration = 0.1f;
+	uint64_t rng = 1;
+	//pattern indexes of the last two positions, kept between games so training doesn't allocate
+	std::vector<int32_t> previous;
+	std::vector<int32_t> current;
+};
+
+inline void NTupleUpdate(NTupleNetwork& network, const std::vector<int32_t>& indexes, float value, float target, float learningRate) noexcept
+{
+	float step = learningRate * (target - value) * (1.0f - value * value);
+	for (int32_t index : indexes)
+	{
+		std::atomic<float>& weight = network.weights[index];
+		weight.store(weight.load(std::memory_order_relaxed) + step, std::memory_order_relaxed);
+	}
+}
+
+//plays one epsilon-greedy game against itself and learns from it with TD(0) on afterstates, returns the number of moves
+inline int NTupleSelfPlay(NTupleNetwork& network, NTupleTrainer& trainer) noexcept
+{
+	Board board;
+	BoardInit(board, network.width, network.height, network.winLength);
+
+	trainer.previous.resize(network.windowCount);
+	trainer.current.resize(network.windowCount);
+
+	bool havePrevious = false;
+	float previousValue = 0.0f;
+
+	while (true)
+	{
+		int8_t side = board.toMove;
+		int16_t moves[MaxBoardCells];
+		int moveCount = GenerateMoves(board, moves);
+
+		int move = -1;
+
+		for (int i = 0; i < moveCount && move < 0; i++)
+		{
+			BoardPlay(board, moves[i]);
+			if (BoardLastMoveWon(board))
+				move = moves[i];
+			BoardUndo(board);
+		}
+
+		if (move < 0)
+		{
+			if ((SplitMix64(trainer.rng) & 0xFFFFFF) < (uint64_t)(trainer.exploration * 0xFFFFFF))
+			{
+				move = moves[SplitMix64(trainer.rng) % moveCount];
+			}
+			else
+			{
+				float bestDelta = -1e30f;
+				for (int i = 0; i < moveCount; i++)
+				{
+					float delta = NTupleMoveDelta(network, board, moves[i], side);
+					if (delta > bestDelta)
+					{
+						bestDelta = delta;
+						move = moves[i];
+					}
+				}
+			}
+		}
+
+		BoardPlay(board, move);
+
+		float sum = 0.0f;
+		for (int window = 0; window < network.windowCount; window++)
+		{
+			trainer.current[window] = network.windowOffsets[window] + NTuplePattern(network, board, window, side);
+			sum += NTupleWeight(network, trainer.current[window]);
+		}
+		float value = std::tanh(sum);
+
+		bool won = BoardIsWinningMove(board, move);
+		bool over = won || BoardIsFull(board);
+
+		if (havePrevious)
+			NTupleUpdate(network, trainer.previous, previousValue, won ? -1.0f : -value, trainer.learningRate);
+
+		if (over)
+		{
+			NTupleUpdate(network, trainer.current, value, won ? 1.0f : 0.0f, trainer.learningRate);
+			return board.moveCount;
+		}
+
+		trainer.previous.swap(trainer.current);
+		previousValue = value;
+		havePrevious = true;
+	}
+}
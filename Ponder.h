@@ -0,0 +1,216 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+#include "Search.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+//while the player is thinking, search the CPU's reply to every move they could make
+
+struct PonderEntry
+{
+	uint64_t key;
+	int reply;
+	int64_t searchNs;
+};
+
+struct PonderStats
+{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	//search time the hits didn't have to spend after the player moved
+	int64_t savedNs = 0;
+};
+
+struct Ponderer;
+inline void PonderShutdown(Ponderer& ponderer) noexcept;
+
+//one worker for the ponderer's whole life, woken for each of the player's turns, and everything it needs sized once,
+//so starting and stopping a search neither spawns a thread nor allocates
+struct Ponderer
+{
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	bool started = false;
+	bool shutdown = false;
+	//a position handed over and not yet picked up, and one being searched
+	bool queued = false;
+	bool searching = false;
+
+	std::atomic<bool> stop = false;
+	//entries below this count are complete and never written again until the next PonderStart
+	std::atomic<int> entryCount = 0;
+	PonderEntry entries[MaxBoardCells];
+
+	//the position the worker searches from, only written while it's idle
+	Board position;
+	SearchLimits limits;
+	int16_t moves[MaxBoardCells];
+	int moveCount = 0;
+
+	TranspositionTable table;
+	bool active = false;
+	PonderStats stats;
+
+	~Ponderer()
+	{
+		PonderShutdown(*this);
+	}
+};
+
+[[nodiscard]]
+inline double PonderHitRate(const PonderStats& stats) noexcept
+{
+	uint64_t probes = stats.hits + stats.misses;
+	return probes == 0 ? 0.0 : (double)stats.hits / (double)probes;
+}
+
+inline void PonderWork(Ponderer& ponderer) noexcept
+{
+	std::unique_lock<std::mutex> lock(ponderer.mutex);
+
+	while (true)
+	{
+		ponderer.wake.wait(lock, [&]() noexcept { return ponderer.queued || ponderer.shutdown; });
+		if (ponderer.shutdown)
+			return;
+
+		ponderer.queued = false;
+		ponderer.searching = true;
+		lock.unlock();
+
+		//replies to the last turn's moves are no use for this one
+		TTClear(ponderer.table);
+
+		Board& board = ponderer.position;
+		for (int i = 0; i < ponderer.moveCount && !ponderer.stop.load(std::memory_order_relaxed); i++)
+		{
+			BoardPlay(board, ponderer.moves[i]);
+
+			SearchResult result = SearchBestMove(board, ponderer.limits, &ponderer.table, &ponderer.stop);
+
+			if (!ponderer.stop.load(std::memory_order_relaxed))
+			{
+				ponderer.entries[i] =
+				{
+					.key = board.hash,
+					.reply = result.bestMove,
+					.searchNs = result.elapsedNs
+				};
+				ponderer.entryCount.store(i + 1, std::memory_order_release);
+			}
+
+			BoardUndo(board);
+		}
+
+		lock.lock();
+		ponderer.searching = false;
+		ponderer.idle.notify_all();
+	}
+}
+
+//sizes the table and starts the worker, the only part that allocates. PonderStart calls it if nothing has yet
+inline void PonderInit(Ponderer& ponderer, size_t tableEntries = 1 << 16)
+{
+	PonderShutdown(ponderer);
+
+	TTResize(ponderer.table, tableEntries);
+	ponderer.shutdown = false;
+	ponderer.started = true;
+	ponderer.worker = std::thread(PonderWork, std::ref(ponderer));
+}
+
+//stops the search and waits for the worker to be idle again, safe to call when nothing is running
+inline void PonderCancel(Ponderer& ponderer) noexcept
+{
+	if (!ponderer.active)
+		return;
+
+	ponderer.stop.store(true, std::memory_order_relaxed);
+
+	{
+		std::unique_lock<std::mutex> lock(ponderer.mutex);
+		ponderer.queued = false;
+		ponderer.idle.wait(lock, [&]() noexcept { return !ponderer.searching; });
+	}
+
+	ponderer.entryCount.store(0, std::memory_order_relaxed);
+	ponderer.active = false;
+}
+
+//stops the worker for good and gives back the table
+inline void PonderShutdown(Ponderer& ponderer) noexcept
+{
+	if (!ponderer.started)
+		return;
+
+	PonderCancel(ponderer);
+
+	{
+		std::lock_guard<std::mutex> lock(ponderer.mutex);
+		ponderer.shutdown = true;
+	}
+	ponderer.wake.notify_one();
+	ponderer.worker.join();
+
+	TTFree(ponderer.table);
+	ponderer.started = false;
+}
+
+//position is the board with the player to move
+inline void PonderStart(Ponderer& ponderer, const Board& position, const SearchLimits& limits)
+{
+	PonderCancel(ponderer);
+
+	if (BoardLastMoveWon(position) || BoardIsFull(position))
+		return;
+
+	if (!ponderer.started)
+		PonderInit(ponderer);
+
+	{
+		std::lock_guard<std::mutex> lock(ponderer.mutex);
+		ponderer.position = position;
+		ponderer.limits = limits;
+		ponderer.moveCount = GenerateMoves(position, ponderer.moves);
+		ponderer.stop.store(false, std::memory_order_relaxed);
+		ponderer.entryCount.store(0, std::memory_order_relaxed);
+		ponderer.queued = true;
+	}
+
+	ponderer.active = true;
+	ponderer.wake.notify_one();
+}
+
+//position is the board right after the player's move, returns false if that reply hasn't been searched yet
+[[nodiscard]]
+inline bool PonderProbe(Ponderer& ponderer, const Board& position, int& reply) noexcept
+{
+	int count = ponderer.active ? ponderer.entryCount.load(std::memory_order_acquire) : 0;
+
+	for (int i = 0; i < count; i++)
+	{
+		if (ponderer.entries[i].key == position.hash)
+		{
+			reply = ponderer.entries[i].reply;
+			ponderer.stats.hits++;
+			ponderer.stats.savedNs += ponderer.entries[i].searchNs;
+			return true;
+		}
+	}
+
+	ponderer.stats.misses++;
+	return false;
+}
@@ -0,0 +1,712 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+#include "Search.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+
+//4x4x4 tic tac toe. each side's stones are one bit per cell, cell z * 16 + y * 4 + x, and a line is won when
+//one side holds all 4 bits of one of the 76 masks below. positions are looked up in the transposition table under the
+//smallest of their 192 symmetric hashes, so every rotated, reflected or scrambled copy of a position is searched once
+
+constexpr int QubicCells = 64;
+constexpr int QubicLineCount = 76;
+constexpr int QubicSymmetryCount = 192;
+
+[[nodiscard]]
+constexpr int QubicCell(int x, int y, int z) noexcept
+{
+	return z * 16 + y * 4 + x;
+}
+
+inline constexpr std::array<uint64_t, QubicLineCount> QubicLines = []
+{
+	std::array<uint64_t, QubicLineCount> lines = {};
+	int count = 0;
+
+	//13 directions, the other 13 are the same lines walked backwards
+	for (int dz = -1; dz <= 1; dz++)
+	for (int dy = -1; dy <= 1; dy++)
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		bool forward = dz > 0 || (dz == 0 && (dy > 0 || (dy == 0 && dx > 0)));
+		if (!forward)
+			continue;
+
+		for (int z = 0; z < 4; z++)
+		for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+		{
+			int endX = x + 3 * dx;
+			int endY = y + 3 * dy;
+			int endZ = z + 3 * dz;
+			if (endX < 0 || endX > 3 || endY < 0 || endY > 3 || endZ < 0 || endZ > 3)
+				continue;
+
+			uint64_t line = 0;
+			for (int i = 0; i < 4; i++)
+				line |= 1ull << QubicCell(x + i * dx, y + i * dy, z + i * dz);
+			lines[count++] = line;
+		}
+	}
+
+	return count == QubicLineCount ? lines : std::array<uint64_t, QubicLineCount>{};
+}();
+
+static_assert(QubicLines[QubicLineCount - 1] != 0, "there are exactly 76 lines");
+
+struct QubicCellLines
+{
+	int count;
+	uint8_t lines[7];
+};
+
+//the 4 or 7 lines through each cell, so checking a move only looks at those
+inline constexpr std::array<QubicCellLines, QubicCells> QubicLinesThrough = []
+{
+	std::array<QubicCellLines, QubicCells> cells = {};
+	for (int line = 0; line < QubicLineCount; line++)
+	{
+		for (int cell = 0; cell < QubicCells; cell++)
+		{
+			if ((QubicLines[line] >> cell) & 1)
+				cells[cell].lines[cells[cell].count++] = (uint8_t)line;
+		}
+	}
+	return cells;
+}();
+
+//the maps of 0..3 onto itself that commute with reversing it. applied to all three axes at once they keep every line a line,
+//and together with the cube's 48 rotations and reflections they make all 192 symmetries of the game
+inline constexpr int QubicScrambles[8][4] =
+{
+	{ 0, 1, 2, 3 }, { 0, 2, 1, 3 }, { 1, 0, 3, 2 }, { 1, 3, 0, 2 },
+	{ 2, 0, 3, 1 }, { 2, 3, 0, 1 }, { 3, 1, 2, 0 }, { 3, 2, 1, 0 }
+};
+
+inline constexpr int QubicAxisOrders[6][3] =
+{
+	{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 }
+};
+
+//[cell][symmetry], cell-major so a move touches one contiguous row
+inline constexpr std::array<std::array<uint8_t, QubicSymmetryCount>, QubicCells> QubicImages = []
+{
+	std::array<std::array<uint8_t, QubicSymmetryCount>, QubicCells> images = {};
+	int symmetry = 0;
+
+	for (const auto& order : QubicAxisOrders)
+	{
+		for (const auto& scramble : QubicScrambles)
+		{
+			//flipping all three axes is already one of the scrambles, so x is never flipped on its own
+			for (int flips = 0; flips < 8; flips += 2)
+			{
+				for (int cell = 0; cell < QubicCells; cell++)
+				{
+					int coordinates[3] = { cell & 3, (cell >> 2) & 3, cell >> 4 };
+					int mapped[3];
+					for (int axis = 0; axis < 3; axis++)
+					{
+						int value = scramble[coordinates[order[axis]]];
+						mapped[axis] = (flips >> axis) & 1 ? 3 - value : value;
+					}
+					images[cell][symmetry] = (uint8_t)QubicCell(mapped[0], mapped[1], mapped[2]);
+				}
+				symmetry++;
+			}
+		}
+	}
+
+	return images;
+}();
+
+//the cell that each symmetry maps onto this one
+inline constexpr std::array<std::array<uint8_t, QubicSymmetryCount>, QubicCells> QubicPreimages = []
+{
+	std::array<std::array<uint8_t, QubicSymmetryCount>, QubicCells> preimages = {};
+	for (int cell = 0; cell < QubicCells; cell++)
+		for (int symmetry = 0; symmetry < QubicSymmetryCount; symmetry++)
+			preimages[QubicImages[cell][symmetry]][symmetry] = (uint8_t)cell;
+	return preimages;
+}();
+
+[[nodiscard]]
+constexpr bool QubicSymmetriesValid() noexcept
+{
+	for (int symmetry = 0; symmetry < QubicSymmetryCount; symmetry++)
+	{
+		for (uint64_t line : QubicLines)
+		{
+			uint64_t image = 0;
+			for (uint64_t cells = line; cells != 0; cells &= cells - 1)
+				image |= 1ull << QubicImages[std::countr_zero(cells)][symmetry];
+
+			//a line through any one of its cells
+			const QubicCellLines& through = QubicLinesThrough[std::countr_zero(image)];
+			bool found = false;
+			for (int i = 0; i < through.count; i++)
+				found |= QubicLines[through.lines[i]] == image;
+			if (!found)
+				return false;
+		}
+
+		//and no two symmetries are the same map
+		for (int other = 0; other < symmetry; other++)
+		{
+			bool same = true;
+			for (int cell = 0; cell < QubicCells && same; cell++)
+				same = QubicImages[cell][symmetry] == QubicImages[cell][other];
+			if (same)
+				return false;
+		}
+	}
+	return true;
+}
+
+static_assert(QubicSymmetriesValid(), "every symmetry maps lines onto lines");
+
+struct QubicBoard
+{
+	//indexed by piece - 1
+	uint64_t stones[2];
+	int8_t toMove;
+	int moveCount;
+	int8_t moves[QubicCells];
+	//stones each side has in each line, so nothing needs to count bits
+	uint8_t lineCounts[2][QubicLineCount];
+	//the position's hash under every symmetry
+	uint64_t hashes[QubicSymmetryCount];
+};
+
+inline void QubicInit(QubicBoard& board) noexcept
+{
+	board.stones[0] = 0;
+	board.stones[1] = 0;
+	board.toMove = PieceX;
+	board.moveCount = 0;
+	for (auto& counts : board.lineCounts)
+		for (uint8_t& count : counts)
+			count = 0;
+	for (uint64_t& hash : board.hashes)
+		hash = 0;
+}
+
+inline void QubicPlay(QubicBoard& board, int cell) noexcept
+{
+	board.stones[board.toMove - 1] |= 1ull << cell;
+
+	const QubicCellLines& through = QubicLinesThrough[cell];
+	for (int i = 0; i < through.count; i++)
+		board.lineCounts[board.toMove - 1][through.lines[i]]++;
+
+	const auto& images = QubicImages[cell];
+	for (int symmetry = 0; symmetry < QubicSymmetryCount; symmetry++)
+		board.hashes[symmetry] ^= ZobristKey(images[symmetry], board.toMove);
+
+	board.moves[board.moveCount++] = (int8_t)cell;
+	board.toMove = OtherPiece(board.toMove);
+}
+
+inline void QubicUndo(QubicBoard& board) noexcept
+{
+	int cell = board.moves[--board.moveCount];
+	board.toMove = OtherPiece(board.toMove);
+
+	const auto& images = QubicImages[cell];
+	for (int symmetry = 0; symmetry < QubicSymmetryCount; symmetry++)
+		board.hashes[symmetry] ^= ZobristKey(images[symmetry], board.toMove);
+
+	const QubicCellLines& through = QubicLinesThrough[cell];
+	for (int i = 0; i < through.count; i++)
+		board.lineCounts[board.toMove - 1][through.lines[i]]--;
+
+	board.stones[board.toMove - 1] &= ~(1ull << cell);
+}
+
+[[nodiscard]]
+inline bool QubicIsWinningMove(const QubicBoard& board, int cell) noexcept
+{
+	uint64_t stones = (board.stones[0] >> cell) & 1 ? board.stones[0] : board.stones[1];
+	const QubicCellLines& through = QubicLinesThrough[cell];
+	for (int i = 0; i < through.count; i++)
+	{
+		uint64_t line = QubicLines[through.lines[i]];
+		if ((stones & line) == line)
+			return true;
+	}
+	return false;
+}
+
+[[nodiscard]]
+inline bool QubicLastMoveWon(const QubicBoard& board) noexcept
+{
+	return board.moveCount != 0 && QubicIsWinningMove(board, board.moves[board.moveCount - 1]);
+}
+
+//true when a line's worth of bits has exactly count of them set
+[[nodiscard]]
+constexpr bool QubicHasStones(uint64_t bits, int count) noexcept
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (bits == 0)
+			return false;
+		bits &= bits - 1;
+	}
+	return bits == 0;
+}
+
+//empty cells that would complete a line for the side holding own
+[[nodiscard]]
+inline uint64_t QubicThreats(uint64_t own, uint64_t other) noexcept
+{
+	uint64_t threats = 0;
+	for (uint64_t line : QubicLines)
+	{
+		uint64_t mine = own & line;
+		if ((other & line) == 0 && QubicHasStones(mine, 3))
+			threats |= line & ~mine;
+	}
+	return threats;
+}
+
+//empty cells that would give the side holding own 3 in an otherwise empty line
+[[nodiscard]]
+inline uint64_t QubicThreatMakers(uint64_t own, uint64_t other) noexcept
+{
+	uint64_t makers = 0;
+	for (uint64_t line : QubicLines)
+	{
+		uint64_t mine = own & line;
+		if ((other & line) == 0 && QubicHasStones(mine, 2))
+			makers |= line & ~mine;
+	}
+	return makers;
+}
+
+//the same from the line counts
+[[nodiscard]]
+inline uint64_t QubicThreats(const QubicBoard& board, int8_t piece) noexcept
+{
+	const uint8_t* own = board.lineCounts[piece - 1];
+	const uint8_t* other = board.lineCounts[2 - piece];
+	uint64_t threats = 0;
+
+	for (int line = 0; line < QubicLineCount; line++)
+	{
+		if (own[line] == 3 && other[line] == 0)
+			threats |= QubicLines[line];
+	}
+	return threats & ~(board.stones[0] | board.stones[1]);
+}
+
+//the smallest of the symmetric hashes, and the symmetry that gave it
+[[nodiscard]]
+inline uint64_t QubicCanonicalHash(const QubicBoard& board, int& symmetry) noexcept
+{
+	uint64_t best = board.hashes[0];
+	symmetry = 0;
+	for (int i = 1; i < QubicSymmetryCount; i++)
+	{
+		if (board.hashes[i] < best)
+		{
+			best = board.hashes[i];
+			symmetry = i;
+		}
+	}
+	return best;
+}
+
+//an open line is worth more the more stones are in it
+inline constexpr int QubicLineWeights[5] = { 0, 1, 6, 40, 0 };
+
+//side to move's point of view
+[[nodiscard]]
+inline int QubicEvaluate(const QubicBoard& board) noexcept
+{
+	const uint8_t* own = board.lineCounts[board.toMove - 1];
+	const uint8_t* other = board.lineCounts[2 - board.toMove];
+	int score = 0;
+
+	for (int line = 0; line < QubicLineCount; line++)
+	{
+		if (other[line] == 0)
+			score += QubicLineWeights[own[line]];
+		else if (own[line] == 0)
+			score -= QubicLineWeights[other[line]];
+	}
+	return score;
+}
+
+struct QubicLimits
+{
+	int maxDepth = QubicCells;
+	uint64_t maxNodes = 0;
+	int64_t maxTimeNs = 0;
+	//attacker moves the threat sequence search may spend before the main search, and at each of its leaves. 0 skips it
+	int rootThreatDepth = 16;
+	int threatDepth = 2;
+	//false looks positions up by their own hash only, to see what the symmetries are worth
+	bool symmetry = true;
+};
+
+struct QubicContext
+{
+	QubicBoard* board;
+	TranspositionTable* table;
+	const std::atomic<bool>* stop;
+	int threatDepth;
+	bool symmetry;
+	uint64_t nodes;
+	uint64_t maxNodes;
+	std::chrono::steady_clock::time_point deadline;
+	bool hasDeadline;
+	bool aborted;
+};
+
+[[nodiscard]]
+inline bool QubicShouldAbort(QubicContext& context) noexcept
+{
+	if (context.aborted)
+		return true;
+
+	if ((context.nodes & 1023) == 0)
+	{
+		if ((context.stop != nullptr && context.stop->load(std::memory_order_relaxed)) ||
+			(context.hasDeadline && std::chrono::steady_clock::now() >= context.deadline))
+			context.aborted = true;
+	}
+
+	if (context.maxNodes != 0 && context.nodes >= context.maxNodes)
+		context.aborted = true;
+
+	return context.aborted;
+}
+
+//the first move of a win for the attacker by a run of single threats, each answered by the only block, ending in two
+//threats at once, or -1 if there's none. depth is how many of its own moves the attacker may spend.
+//it only ever needs the two bitboards, so it skips the hashing QubicPlay does
+[[nodiscard]]
+inline int QubicThreatWin(uint64_t attacker, uint64_t defender, int depth, uint64_t& nodes) noexcept
+{
+	nodes++;
+
+	uint64_t wins = QubicThreats(attacker, defender);
+	if (wins != 0)
+		return std::countr_zero(wins);
+
+	uint64_t blocks = QubicThreats(defender, attacker);
+	if (depth == 0 || (blocks & (blocks - 1)) != 0)
+		return -1;
+
+	//with a threat against it the attacker has to block, and only gets to go on if the block threatens too
+	uint64_t candidates = QubicThreatMakers(attacker, defender);
+	if (blocks != 0)
+		candidates &= blocks;
+
+	for (; candidates != 0; candidates &= candidates - 1)
+	{
+		int cell = std::countr_zero(candidates);
+		uint64_t played = attacker | (1ull << cell);
+		uint64_t threats = QubicThreats(played, defender);
+
+		if ((threats & (threats - 1)) != 0)
+			return cell;
+
+		//the one reply, which may in turn threaten and force the attacker's hand
+		if (threats != 0 && QubicThreatWin(played, defender | threats, depth - 1, nodes) >= 0)
+			return cell;
+	}
+
+	return -1;
+}
+
+//empty cells on the most open lines first, counting both sides' lines since taking one of the opponent's is worth as much.
+//returns how many there are
+inline int QubicOrderMoves(const QubicBoard& board, int firstMove, int8_t* moves) noexcept
+{
+	int values[QubicCells];
+	int moveCount = 0;
+	const uint8_t* own = board.lineCounts[board.toMove - 1];
+	const uint8_t* other = board.lineCounts[2 - board.toMove];
+
+	for (uint64_t remaining = ~(board.stones[0] | board.stones[1]); remaining != 0; remaining &= remaining - 1)
+	{
+		int cell = std::countr_zero(remaining);
+		int value = cell == firstMove ? 1 << 20 : 0;
+
+		const QubicCellLines& through = QubicLinesThrough[cell];
+		for (int i = 0; i < through.count; i++)
+		{
+			int line = through.lines[i];
+			if (other[line] == 0)
+				value += 1 + QubicLineWeights[own[line]];
+			if (own[line] == 0)
+				value += 1 + QubicLineWeights[other[line]];
+		}
+
+		int i = moveCount++;
+		for (; i > 0 && values[i - 1] < value; i--)
+		{
+			values[i] = values[i - 1];
+			moves[i] = moves[i - 1];
+		}
+		values[i] = value;
+		moves[i] = (int8_t)cell;
+	}
+
+	return moveCount;
+}
+
+//immediate wins are taken, single threats blocked without spending depth, and two threats at once are lost
+[[nodiscard]]
+inline int QubicNegamax(QubicContext& context, int depth, int alpha, int beta, int ply) noexcept
+{
+	QubicBoard& board = *context.board;
+	context.nodes++;
+
+	int8_t side = board.toMove;
+	int8_t opponent = OtherPiece(side);
+	uint64_t empty = ~(board.stones[0] | board.stones[1]);
+
+	if (empty == 0)
+		return 0;
+
+	if (QubicThreats(board, side) != 0)
+		return WinScore - ply - 1;
+
+	uint64_t blocks = QubicThreats(board, opponent);
+	if ((blocks & (blocks - 1)) != 0)
+		return -(WinScore - ply - 2);
+
+	if (depth <= 0 && blocks == 0)
+	{
+		if (context.threatDepth != 0 && QubicThreatWin(board.stones[side - 1], board.stones[opponent - 1], context.threatDepth, context.nodes) >= 0)
+			return WinScore - ply - 2 * context.threatDepth - 1;
+		return QubicEvaluate(board);
+	}
+
+	if (QubicShouldAbort(context))
+		return 0;
+
+	int symmetry = 0;
+	uint64_t key = context.symmetry ? QubicCanonicalHash(board, symmetry) : board.hashes[0];
+
+	int ttMove = -1;
+	TTEntry* entry = nullptr;
+
+	if (context.table != nullptr && context.table->entries != nullptr)
+	{
+		entry = &context.table->entries[key & context.table->mask];
+		context.table->probes++;
+		if (entry->key == key && entry->bound != BoundNone)
+		{
+			context.table->hits++;
+			//stored in the canonical orientation, and a different position with the same key could have left anything there
+			if (entry->move >= 0 && entry->move < QubicCells)
+				ttMove = QubicPreimages[entry->move][symmetry];
+			if (entry->depth >= depth)
+			{
+				int score = ScoreFromTT(entry->score, ply);
+				if (entry->bound == BoundExact ||
+					(entry->bound == BoundLower && score >= beta) ||
+					(entry->bound == BoundUpper && score <= alpha))
+					return score;
+			}
+		}
+	}
+
+	int8_t moves[QubicCells];
+	int moveCount = 0;
+
+	if (blocks != 0)
+	{
+		moves[moveCount++] = (int8_t)std::countr_zero(blocks);
+	}
+	else
+	{
+		moveCount = QubicOrderMoves(board, ttMove, moves);
+	}
+
+	int originalAlpha = alpha;
+	int bestScore = -WinScore - 1;
+	int bestMove = -1;
+
+	//a forced block doesn't use up depth
+	int childDepth = blocks != 0 ? depth : depth - 1;
+
+	for (int i = 0; i < moveCount; i++)
+	{
+		QubicPlay(board, moves[i]);
+		int score = -QubicNegamax(context, childDepth, -beta, -alpha, ply + 1);
+		QubicUndo(board);
+
+		if (context.aborted)
+			return 0;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestMove = moves[i];
+		}
+
+		if (score > alpha)
+			alpha = score;
+
+		if (alpha >= beta)
+			break;
+	}
+
+	if (entry != nullptr && bestMove >= 0)
+	{
+		*entry = TTEntry
+		{
+			.key = key,
+			.score = (int16_t)ScoreToTT(bestScore, ply),
+			.move = (int16_t)QubicImages[bestMove][symmetry],
+			.depth = (int8_t)(depth < 127 ? depth : 127),
+			.bound = bestScore <= originalAlpha ? BoundUpper : bestScore >= beta ? BoundLower : BoundExact,
+			.padding = 0
+		};
+	}
+
+	return bestScore;
+}
+
+//iterative deepening until a limit is hit or the result is known, bestMove is -1 only if the game is already over
+[[nodiscard]]
+inline SearchResult QubicSearchBestMove(QubicBoard& board, const QubicLimits& limits, TranspositionTable* table = nullptr, const std::atomic<bool>* stop = nullptr) noexcept
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	SearchResult result =
+	{
+		.bestMove = -1,
+		.score = 0,
+		.depth = 0,
+		.nodes = 0,
+		.elapsedNs = 0,
+		.solved = true
+	};
+
+	if (QubicLastMoveWon(board) || board.moveCount == QubicCells)
+		return result;
+
+	QubicContext context =
+	{
+		.board = &board,
+		.table = table,
+		.stop = stop,
+		.threatDepth = limits.threatDepth,
+		.symmetry = limits.symmetry,
+		.nodes = 0,
+		.maxNodes = limits.maxNodes,
+		.deadline = startTime + std::chrono::nanoseconds(limits.maxTimeNs),
+		.hasDeadline = limits.maxTimeNs > 0,
+		.aborted = false
+	};
+
+	uint64_t wins = QubicThreats(board, board.toMove);
+	uint64_t blocks = QubicThreats(board, OtherPiece(board.toMove));
+
+	if (wins != 0)
+	{
+		result.bestMove = std::countr_zero(wins);
+		result.score = WinScore - 1;
+		result.depth = 1;
+		result.nodes = 1;
+		result.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+		return result;
+	}
+
+	int8_t moves[QubicCells];
+	int moveCount = 1;
+	if (blocks != 0)
+		moves[0] = (int8_t)std::countr_zero(blocks);
+	else
+		moveCount = QubicOrderMoves(board, -1, moves);
+
+	//a threat sequence is the quickest way to a proven win when there is one
+	if (blocks == 0)
+	{
+		for (int depth = 1; depth <= limits.rootThreatDepth; depth++)
+		{
+			int move = QubicThreatWin(board.stones[board.toMove - 1], board.stones[2 - board.toMove], depth, context.nodes);
+			if (move >= 0)
+			{
+				result.bestMove = move;
+				result.score = WinScore - (2 * depth + 1);
+				result.depth = 2 * depth + 1;
+				result.nodes = context.nodes;
+				result.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+				return result;
+			}
+		}
+	}
+
+	result.bestMove = moves[0];
+	result.solved = false;
+
+	int emptyCells = QubicCells - board.moveCount;
+	int maxDepth = limits.maxDepth < emptyCells ? limits.maxDepth : emptyCells;
+
+	for (int depth = 1; depth <= maxDepth; depth++)
+	{
+		int alpha = -WinScore - 1;
+		int beta = WinScore + 1;
+		int bestMove = moves[0];
+
+		for (int i = 0; i < moveCount; i++)
+		{
+			QubicPlay(board, moves[i]);
+			int score = -QubicNegamax(context, depth - 1, -beta, -alpha, 1);
+			QubicUndo(board);
+
+			if (context.aborted)
+				break;
+
+			if (score > alpha)
+			{
+				alpha = score;
+				bestMove = moves[i];
+			}
+		}
+
+		if (context.aborted)
+			break;
+
+		for (int i = 0; i < moveCount; i++)
+		{
+			if (moves[i] == bestMove)
+			{
+				for (; i > 0; i--)
+					moves[i] = moves[i - 1];
+				moves[0] = (int8_t)bestMove;
+				break;
+			}
+		}
+
+		result.bestMove = bestMove;
+		result.score = alpha;
+		result.depth = depth;
+		result.solved = depth == emptyCells || alpha > DecisiveScore || alpha < -DecisiveScore;
+
+		if (result.solved)
+			break;
+	}
+
+	result.nodes = context.nodes;
+	result.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	return result;
+}
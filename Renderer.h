@@ -0,0 +1,408 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+//what the menu and the board look like, independent of what draws them.
+//things that only change when the window does (grid, labels, title) are drawn once into a cached layer,
+//every frame only composites those layers and draws what actually moves
+
+struct RenderRect
+{
+	float left;
+	float top;
+	float right;
+	float bottom;
+};
+
+struct RenderPoint
+{
+	float x;
+	float y;
+};
+
+enum RenderColor
+{
+	ColorHighlight,
+	ColorPlayer,
+	ColorCPU,
+	ColorGhost,
+	ColorCount
+};
+
+enum RenderFont
+{
+	FontTitle,
+	FontLabel,
+	FontCopyright,
+	FontCount
+};
+
+enum RenderLayer
+{
+	LayerMenu,
+	LayerBoard,
+	LayerCount
+};
+
+struct RenderBackend
+{
+	virtual ~RenderBackend() = default;
+
+	virtual void BeginFrame() noexcept = 0;
+	virtual void EndFrame() noexcept = 0;
+	virtual void Clear() noexcept = 0;
+
+	virtual void FillRect(const RenderRect& rect, RenderColor color) noexcept = 0;
+	virtual void DrawSegment(RenderPoint from, RenderPoint to, RenderColor color, float width) noexcept = 0;
+	virtual void DrawCircle(RenderPoint centre, float radius, RenderColor color, float width) noexcept = 0;
+	virtual void DrawLabel(const wchar_t* text, uint32_t length, RenderFont font, const RenderRect& area, RenderColor color) noexcept = 0;
+
+	//draws between BeginLayer and EndLayer go into the layer's own surface instead of the frame, called outside BeginFrame/EndFrame
+	virtual void BeginLayer(RenderLayer layer) noexcept = 0;
+	virtual void EndLayer() noexcept = 0;
+	virtual void DrawLayer(RenderLayer layer) noexcept = 0;
+};
+
+enum MenuButton
+{
+	MenuButtonNone,
+	MenuButtonPlay,
+	MenuButtonExit
+};
+
+struct SceneLayout
+{
+	int width;
+	int height;
+
+	RenderRect titleArea;
+	RenderRect playArea;
+	RenderRect exitArea;
+	RenderRect copyrightArea;
+	RenderRect playHitArea;
+	RenderRect exitHitArea;
+
+	RenderRect youArea;
+	RenderRect playerScoreArea;
+	RenderRect CPUArea;
+	RenderRect CPUScoreArea;
+
+	RenderRect boardArea;
+	float boardWidth;
+	float lineWidth;
+	float squareSize;
+	RenderRect gridLines[4];
+	RenderPoint squarePoints[9];
+};
+
+//a score as text, formatted again only when it changes, so drawing it every frame neither formats nor allocates
+struct ScoreText
+{
+	int64_t value = INT64_MIN;
+	uint32_t length = 0;
+	//the longest int64_t is 19 digits and a sign
+	wchar_t text[24] = {};
+};
+
+struct LayerCache
+{
+	//turned off, every frame draws everything like it used to, which is what the benchmark compares against
+	bool enabled = true;
+	bool valid[LayerCount] = {};
+
+	//kept across invalidations, a resize doesn't change the scores
+	ScoreText playerScore;
+	ScoreText CPUScore;
+};
+
+inline void InvalidateLayers(LayerCache& cache) noexcept
+{
+	for (bool& valid : cache.valid)
+		valid = false;
+}
+
+[[nodiscard]]
+inline const ScoreText& ScoreTextFor(ScoreText& score, int64_t value) noexcept
+{
+	if (value == score.value && score.length != 0)
+		return score;
+
+	//digits backwards from the end, through the unsigned magnitude so INT64_MIN has one too
+	wchar_t digits[24];
+	uint32_t count = 0;
+	uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+	do
+	{
+		digits[count++] = (wchar_t)(L'0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude != 0);
+
+	uint32_t length = 0;
+	if (value < 0)
+		score.text[length++] = L'-';
+	while (count != 0)
+		score.text[length++] = digits[--count];
+	score.text[length] = 0;
+
+	score.value = value;
+	score.length = length;
+	return score;
+}
+
+inline void ComputeLayout(SceneLayout& layout, int windowWidth, int windowHeight) noexcept
+{
+	layout.width = windowWidth;
+	layout.height = windowHeight;
+
+	layout.titleArea = { 0, windowHeight * .1f, (float)windowWidth, windowHeight * .8f };
+	layout.playArea = { 0, windowHeight * .3f, (float)windowWidth, windowHeight * .8f };
+	layout.exitArea = { 0, windowHeight * .45f, (float)windowWidth, windowHeight * .8f };
+	layout.copyrightArea = { 0, windowHeight * .9f, (float)windowWidth, windowHeight * 1.f };
+	layout.playHitArea = { windowWidth * .4f, windowHeight * .3f, windowWidth * .6f, windowHeight * .4f };
+	layout.exitHitArea = { windowWidth * .4f, windowHeight * .45f, windowWidth * .6f, windowHeight * .55f };
+
+	float scoreWidth = .2f * windowWidth;
+	float labelBottom = (.1f / .5f) * windowHeight;
+
+	layout.youArea = { 0, 0, (float)windowWidth / 2 - scoreWidth, labelBottom };
+	layout.playerScoreArea = { (float)windowWidth / 2 - scoreWidth, 0, (float)windowWidth / 2, labelBottom };
+	layout.CPUArea = { (float)windowWidth / 2 + scoreWidth, 0, (float)windowWidth, labelBottom };
+	layout.CPUScoreArea = { (float)windowWidth / 2, 0, (float)windowWidth / 2 + scoreWidth, labelBottom };
+
+	RenderRect boardArea =
+	{
+		.left = .205f / 2 * (float)windowWidth,
+		.top = (.1f / .8f) * windowHeight,
+		.right = (float)windowWidth - .205f / 2 * (float)windowWidth,
+		.bottom = (float)windowHeight - .08f * windowHeight
+	};
+
+	float boardWidth = boardArea.right - boardArea.left;
+	float lineWidth = (float)windowWidth * .02f;
+	float squareSize = (boardWidth - lineWidth * 2) / 3.f;
+
+	layout.boardArea = boardArea;
+	layout.boardWidth = boardWidth;
+	layout.lineWidth = lineWidth;
+	layout.squareSize = squareSize;
+
+	//two vertical lines then two horizontal
+	layout.gridLines[0] = { boardArea.left + squareSize, boardArea.top, boardArea.left + squareSize + lineWidth, boardArea.bottom };
+	layout.gridLines[1] = { boardArea.left + squareSize * 2 + lineWidth, boardArea.top, boardArea.left + squareSize * 2 + lineWidth * 2, boardArea.bottom };
+	layout.gridLines[2] = { boardArea.left, boardArea.top + squareSize, boardArea.right, boardArea.top + squareSize + lineWidth };
+	layout.gridLines[3] = { boardArea.left, boardArea.top + squareSize * 2 + lineWidth, boardArea.right, boardArea.top + squareSize * 2 + lineWidth * 2 };
+
+	for (int i = 0; i < 9; i++)
+	{
+		layout.squarePoints[i] =
+		{
+			boardArea.left + squareSize * (i % 3) + lineWidth * (i % 3),
+			boardArea.top + squareSize * (i / 3) + lineWidth * (i / 3)
+		};
+	}
+}
+
+[[nodiscard]]
+constexpr bool RectContains(const RenderRect& rect, float x, float y) noexcept
+{
+	return x > rect.left && x < rect.right && y > rect.top && y < rect.bottom;
+}
+
+[[nodiscard]]
+inline MenuButton MenuHitTest(const SceneLayout& layout, float x, float y) noexcept
+{
+	if (RectContains(layout.playHitArea, x, y))
+		return MenuButtonPlay;
+	if (RectContains(layout.exitHitArea, x, y))
+		return MenuButtonExit;
+	return MenuButtonNone;
+}
+
+//the square under the point, 9 for none
+[[nodiscard]]
+inline int BoardHitTest(const SceneLayout& layout, float x, float y) noexcept
+{
+	if (!RectContains(layout.boardArea, x, y))
+		return 9;
+
+	for (int i = 0; i < 9; i++)
+	{
+		RenderRect square =
+		{
+			layout.squarePoints[i].x,
+			layout.squarePoints[i].y,
+			layout.squarePoints[i].x + layout.squareSize,
+			layout.squarePoints[i].y + layout.squareSize
+		};
+
+		if (RectContains(square, x, y))
+			return i;
+	}
+
+	return 9;
+}
+
+inline void DrawMenuStatic(RenderBackend& backend, const SceneLayout& layout) noexcept
+{
+	//title
+	backend.DrawLabel(L" TIC          TOE", 17, FontTitle, layout.titleArea, ColorPlayer);
+	backend.DrawLabel(L"TAC", 3, FontTitle, layout.titleArea, ColorCPU);
+
+	backend.DrawLabel(L"PLAY", 4, FontLabel, layout.playArea, ColorGhost);
+	backend.DrawLabel(L"EXIT", 4, FontLabel, layout.exitArea, ColorGhost);
+
+	backend.DrawLabel(L"\u24B8 2023 badasahog. All Rights Reserved", 37, FontCopyright, layout.copyrightArea, ColorGhost);
+}
+
+inline void DrawBoardStatic(RenderBackend& backend, const SceneLayout& layout) noexcept
+{
+	backend.DrawLabel(L"YOU", 3, FontLabel, layout.youArea, ColorPlayer);
+	backend.DrawLabel(L"CPU", 3, FontLabel, layout.CPUArea, ColorCPU);
+
+	for (const RenderRect& line : layout.gridLines)
+		backend.FillRect(line, ColorHighlight);
+}
+
+//puts the cached layer in the frame, or with caching turned off draws its contents straight in
+template<typename DrawStatic>
+inline void CompositeLayer(RenderBackend& backend, LayerCache& cache, RenderLayer layer, DrawStatic drawStatic) noexcept
+{
+	if (!cache.enabled)
+	{
+		drawStatic();
+		return;
+	}
+
+	backend.DrawLayer(layer);
+}
+
+//redraws the layer's surface if it was invalidated
+template<typename DrawStatic>
+inline void PrepareLayer(RenderBackend& backend, LayerCache& cache, RenderLayer layer, DrawStatic drawStatic) noexcept
+{
+	if (!cache.enabled || cache.valid[layer])
+		return;
+
+	backend.BeginLayer(layer);
+	drawStatic();
+	backend.EndLayer();
+	cache.valid[layer] = true;
+}
+
+inline void RenderMenu(RenderBackend& backend, LayerCache& cache, const SceneLayout& layout, MenuButton hover) noexcept
+{
+	auto drawStatic = [&]() noexcept { DrawMenuStatic(backend, layout); };
+
+	PrepareLayer(backend, cache, LayerMenu, drawStatic);
+
+	backend.BeginFrame();
+	backend.Clear();
+
+	CompositeLayer(backend, cache, LayerMenu, drawStatic);
+
+	if (hover == MenuButtonPlay)
+		backend.DrawLabel(L"PLAY", 4, FontLabel, layout.playArea, ColorHighlight);
+	else if (hover == MenuButtonExit)
+		backend.DrawLabel(L"EXIT", 4, FontLabel, layout.exitArea, ColorHighlight);
+
+	backend.EndFrame();
+}
+
+inline void DrawCross(RenderBackend& backend, const SceneLayout& layout, int square, RenderColor color) noexcept
+{
+	RenderPoint corner = layout.squarePoints[square];
+	float size = layout.squareSize;
+	float inset = size * .08f;
+
+	backend.DrawSegment({ corner.x + inset, corner.y + inset }, { corner.x + size - inset, corner.y + size - inset }, color, size * .15f);
+	backend.DrawSegment({ corner.x + size - inset, corner.y + inset }, { corner.x + inset, corner.y + size - inset }, color, size * .15f);
+}
+
+//first and last square of each line, in the order CheckForWinner numbers them from 1
+constexpr int WinLineSquares[8][2] = { { 0, 2 }, { 3, 5 }, { 6, 8 }, { 0, 6 }, { 1, 7 }, { 2, 8 }, { 0, 8 }, { 2, 6 } };
+
+struct GameFrame
+{
+	const char* boardState;
+	//square to draw the grey X in, 9 for none
+	int ghostSquare;
+	//0 while nobody has won
+	int winType;
+	int64_t playerScore;
+	int64_t CPUScore;
+};
+
+inline void RenderGame(RenderBackend& backend, LayerCache& cache, const SceneLayout& layout, const GameFrame& frame) noexcept
+{
+	auto drawStatic = [&]() noexcept { DrawBoardStatic(backend, layout); };
+
+	PrepareLayer(backend, cache, LayerBoard, drawStatic);
+
+	backend.BeginFrame();
+	backend.Clear();
+
+	CompositeLayer(backend, cache, LayerBoard, drawStatic);
+
+	const ScoreText& playerScore = ScoreTextFor(cache.playerScore, frame.playerScore);
+	backend.DrawLabel(playerScore.text, playerScore.length, FontLabel, layout.playerScoreArea, ColorPlayer);
+
+	const ScoreText& CPUScore = ScoreTextFor(cache.CPUScore, frame.CPUScore);
+	backend.DrawLabel(CPUScore.text, CPUScore.length, FontLabel, layout.CPUScoreArea, ColorCPU);
+
+	float squareSize = layout.squareSize;
+
+	//draw the pieces (or whatever they're called)
+	for (int i = 0; i < 9; i++)
+	{
+		switch (frame.boardState[i])
+		{
+		case 1://O
+			backend.DrawCircle(
+				{ layout.squarePoints[i].x + squareSize / 2, layout.squarePoints[i].y + squareSize / 2 },
+				squareSize * .3f,
+				ColorCPU,
+				squareSize * .15f);
+			break;
+		case 2://X
+			DrawCross(backend, layout, i, ColorPlayer);
+			break;
+		}
+	}
+
+	if (frame.ghostSquare != 9)
+		DrawCross(backend, layout, frame.ghostSquare, ColorGhost);
+
+	if (frame.winType >= 1 && frame.winType <= 8)
+	{
+		int first = WinLineSquares[frame.winType - 1][0];
+		int last = WinLineSquares[frame.winType - 1][1];
+
+		//step from one square to the next along the line
+		float dx = (float)(last % 3 - first % 3) / 2;
+		float dy = (float)(last / 3 - first / 3) / 2;
+
+		float reach = squareSize / 2 - layout.boardWidth * .05f;
+
+		RenderPoint from =
+		{
+			layout.squarePoints[first].x + squareSize / 2 - dx * reach,
+			layout.squarePoints[first].y + squareSize / 2 - dy * reach
+		};
+
+		RenderPoint to =
+		{
+			layout.squarePoints[last].x + squareSize / 2 + dx * reach,
+			layout.squarePoints[last].y + squareSize / 2 + dy * reach
+		};
+
+		backend.DrawSegment(from, to, ColorHighlight, squareSize * .25f);
+	}
+
+	backend.EndFrame();
+}
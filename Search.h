@@ -0,0 +1,560 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+#include "ThreatSpace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//iterative deepening alpha-beta over a Board, scores are always from the side to move's point of view
+
+constexpr int WinScore = 30000;
+constexpr int DecisiveScore = WinScore - MaxBoardCells - 1;
+
+using BoardEvaluator = int(*)(const Board& board) noexcept;
+struct SearchInfo;
+using SearchInfoCallback = void(*)(const SearchInfo& info, void* context) noexcept;
+
+struct SearchLimits
+{
+	int maxDepth = MaxBoardCells;
+	uint64_t maxNodes = 0;
+	int64_t maxTimeNs = 0;
+	//shuffles the root moves so equally good replies aren't always picked in the same order, 0 keeps them sorted
+	uint32_t seed = 0;
+	BoardEvaluator evaluate = nullptr;
+	//nodes the threat-space search may spend looking for a forced win before the main search, 0 skips it
+	uint64_t threatNodes = 0;
+	SearchInfoCallback onInfo = nullptr;
+	void* infoContext = nullptr;
+};
+
+struct SearchInfo
+{
+	int depth;
+	int score;
+	int bestMove;
+	uint64_t nodes;
+	int64_t elapsedNs;
+};
+
+struct SearchResult
+{
+	int bestMove;
+	int score;
+	int depth;
+	uint64_t nodes;
+	int64_t elapsedNs;
+	//true when the score is exact: the tree was searched to the end or a forced result was found
+	bool solved;
+};
+
+enum : uint8_t
+{
+	BoundNone = 0,
+	BoundExact = 1,
+	BoundLower = 2,
+	BoundUpper = 3
+};
+
+struct TTEntry
+{
+	uint64_t key;
+	int16_t score;
+	int16_t move;
+	int8_t depth;
+	uint8_t bound;
+	uint16_t padding;
+};
+
+static_assert(sizeof(TTEntry) == 16);
+
+struct TranspositionTable
+{
+	//points into storage, or into a file mapped copy-on-write by TTMap
+	TTEntry* entries = nullptr;
+	uint64_t mask = 0;
+	std::vector<TTEntry> storage;
+
+	//set while entries is a mapping, TTFree calls it to hand the mapping back
+	void (*unmap)(TranspositionTable& table) noexcept = nullptr;
+	void* mapping = nullptr;
+	size_t mappingBytes = 0;
+
+	//lookups and key matches since the table was last sized, loaded or cleared
+	uint64_t probes = 0;
+	uint64_t hits = 0;
+
+	TranspositionTable() = default;
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+	~TranspositionTable()
+	{
+		if (unmap != nullptr)
+			unmap(*this);
+	}
+};
+
+[[nodiscard]]
+inline size_t TTSize(const TranspositionTable& table) noexcept
+{
+	return table.entries != nullptr ? (size_t)table.mask + 1 : 0;
+}
+
+inline void TTFree(TranspositionTable& table) noexcept
+{
+	if (table.unmap != nullptr)
+		table.unmap(table);
+
+	std::vector<TTEntry>().swap(table.storage);
+	table.entries = nullptr;
+	table.mask = 0;
+	table.probes = 0;
+	table.hits = 0;
+}
+
+//entryCount is rounded down to a power of two
+inline void TTResize(TranspositionTable& table, size_t entryCount)
+{
+	size_t size = 1;
+	while (size * 2 <= entryCount)
+		size *= 2;
+
+	TTFree(table);
+	table.storage.assign(size, TTEntry{});
+	table.entries = table.storage.data();
+	table.mask = size - 1;
+}
+
+inline void TTClear(TranspositionTable& table) noexcept
+{
+	size_t size = TTSize(table);
+	for (size_t i = 0; i < size; i++)
+		table.entries[i] = TTEntry{};
+
+	table.probes = 0;
+	table.hits = 0;
+}
+
+//adds up 4^n for every winLength window holding n stones of one side and none of the other
+[[nodiscard]]
+inline int EvaluateLines(const Board& board) noexcept
+{
+	int score = 0;
+
+	for (const auto& direction : BoardDirections)
+	{
+		int dx = direction[0];
+		int dy = direction[1];
+
+		for (int y = 0; y < board.height; y++)
+		{
+			int endY = y + dy * (board.winLength - 1);
+			if (endY < 0 || endY >= board.height)
+				continue;
+
+			for (int x = 0; x + dx * (board.winLength - 1) < board.width; x++)
+			{
+				int counts[3] = { 0 };
+				for (int i = 0; i < board.winLength; i++)
+					counts[board.cells[(y + dy * i) * board.width + x + dx * i]]++;
+
+				if (counts[PieceO] != 0 && counts[PieceX] != 0)
+					continue;
+
+				int stones = counts[PieceO] + counts[PieceX];
+				int weight = 1 << (2 * (stones < 12 ? stones : 12));
+				score += counts[PieceO] != 0 ? weight : -weight;
+			}
+		}
+	}
+
+	score /= 4;
+	if (score > DecisiveScore / 2)
+		score = DecisiveScore / 2;
+	if (score < -DecisiveScore / 2)
+		score = -DecisiveScore / 2;
+
+	return board.toMove == PieceO ? score : -score;
+}
+
+struct SearchContext
+{
+	Board* board;
+	TranspositionTable* table;
+	const std::atomic<bool>* stop;
+	BoardEvaluator evaluate;
+	uint64_t nodes;
+	uint64_t maxNodes;
+	std::chrono::steady_clock::time_point deadline;
+	bool hasDeadline;
+	bool aborted;
+};
+
+//small boards consider every empty cell, bigger ones only cells within 2 of a stone
+[[nodiscard]]
+inline int GenerateMoves(const Board& board, int16_t* moves) noexcept
+{
+	int cellCount = BoardCellCount(board);
+	int moveCount = 0;
+
+	if (cellCount <= 25 || board.moveCount == 0)
+	{
+		if (board.moveCount == 0 && cellCount > 25)
+		{
+			moves[0] = (int16_t)((board.height / 2) * board.width + board.width / 2);
+			return 1;
+		}
+
+		for (int i = 0; i < cellCount; i++)
+		{
+			if (board.cells[i] == PieceNone)
+				moves[moveCount++] = (int16_t)i;
+		}
+	}
+	else
+	{
+		bool seen[MaxBoardCells] = { false };
+
+		for (int m = 0; m < board.moveCount; m++)
+		{
+			int x = board.moves[m] % board.width;
+			int y = board.moves[m] / board.width;
+
+			for (int ny = y - 2; ny <= y + 2; ny++)
+			{
+				if (ny < 0 || ny >= board.height)
+					continue;
+
+				for (int nx = x - 2; nx <= x + 2; nx++)
+				{
+					if (nx < 0 || nx >= board.width)
+						continue;
+
+					int cell = ny * board.width + nx;
+					if (!seen[cell] && board.cells[cell] == PieceNone)
+					{
+						seen[cell] = true;
+						moves[moveCount++] = (int16_t)cell;
+					}
+				}
+			}
+		}
+	}
+
+	//closest to the centre first
+	auto centreDistance = [&board](int cell) noexcept
+	{
+		int dx = 2 * (cell % board.width) - (board.width - 1);
+		int dy = 2 * (cell / board.width) - (board.height - 1);
+		return dx * dx + dy * dy;
+	};
+
+	for (int i = 1; i < moveCount; i++)
+	{
+		int16_t move = moves[i];
+		int distance = centreDistance(move);
+		int j = i;
+		for (; j > 0 && centreDistance(moves[j - 1]) > distance; j--)
+			moves[j] = moves[j - 1];
+		moves[j] = move;
+	}
+
+	return moveCount;
+}
+
+[[nodiscard]]
+inline int ScoreToTT(int score, int ply) noexcept
+{
+	if (score > DecisiveScore)
+		return score + ply;
+	if (score < -DecisiveScore)
+		return score - ply;
+	return score;
+}
+
+[[nodiscard]]
+inline int ScoreFromTT(int score, int ply) noexcept
+{
+	if (score > DecisiveScore)
+		return score - ply;
+	if (score < -DecisiveScore)
+		return score + ply;
+	return score;
+}
+
+[[nodiscard]]
+inline bool SearchShouldAbort(SearchContext& context) noexcept
+{
+	if (context.aborted)
+		return true;
+
+	if ((context.nodes & 1023) == 0)
+	{
+		if ((context.stop != nullptr && context.stop->load(std::memory_order_relaxed)) ||
+			(context.hasDeadline && std::chrono::steady_clock::now() >= context.deadline))
+			context.aborted = true;
+	}
+
+	if (context.maxNodes != 0 && context.nodes >= context.maxNodes)
+		context.aborted = true;
+
+	return context.aborted;
+}
+
+inline int Negamax(SearchContext& context, int depth, int alpha, int beta, int ply) noexcept
+{
+	Board& board = *context.board;
+	context.nodes++;
+
+	if (BoardLastMoveWon(board))
+		return -(WinScore - ply);
+
+	if (BoardIsFull(board))
+		return 0;
+
+	if (depth == 0)
+		return context.evaluate(board);
+
+	if (SearchShouldAbort(context))
+		return 0;
+
+	int ttMove = -1;
+	TTEntry* entry = nullptr;
+
+	if (context.table != nullptr && context.table->entries != nullptr)
+	{
+		entry = &context.table->entries[board.hash & context.table->mask];
+		context.table->probes++;
+		if (entry->key == board.hash && entry->bound != BoundNone)
+		{
+			context.table->hits++;
+			ttMove = entry->move;
+			if (entry->depth >= depth)
+			{
+				int score = ScoreFromTT(entry->score, ply);
+				if (entry->bound == BoundExact ||
+					(entry->bound == BoundLower && score >= beta) ||
+					(entry->bound == BoundUpper && score <= alpha))
+					return score;
+			}
+		}
+	}
+
+	int16_t moves[MaxBoardCells];
+	int moveCount = GenerateMoves(board, moves);
+
+	for (int i = 0; i < moveCount; i++)
+	{
+		if (moves[i] == ttMove)
+		{
+			moves[i] = moves[0];
+			moves[0] = (int16_t)ttMove;
+			break;
+		}
+	}
+
+	int originalAlpha = alpha;
+	int bestScore = -WinScore - 1;
+	int bestMove = moves[0];
+
+	for (int i = 0; i < moveCount; i++)
+	{
+		BoardPlay(board, moves[i]);
+		int score = -Negamax(context, depth - 1, -beta, -alpha, ply + 1);
+		BoardUndo(board);
+
+		if (context.aborted)
+			return 0;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestMove = moves[i];
+		}
+
+		if (score > alpha)
+			alpha = score;
+
+		if (alpha >= beta)
+			break;
+	}
+
+	if (entry != nullptr)
+	{
+		*entry =
+		{
+			.key = board.hash,
+			.score = (int16_t)ScoreToTT(bestScore, ply),
+			.move = (int16_t)bestMove,
+			.depth = (int8_t)(depth < 127 ? depth : 127),
+			.bound = bestScore <= originalAlpha ? BoundUpper : bestScore >= beta ? BoundLower : BoundExact,
+			.padding = 0
+		};
+	}
+
+	return bestScore;
+}
+
+//board is restored before returning, bestMove is -1 only if the position is already over
+[[nodiscard]]
+inline SearchResult SearchBestMove(Board& board, const SearchLimits& limits, TranspositionTable* table = nullptr, const std::atomic<bool>* stop = nullptr) noexcept
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	SearchResult result =
+	{
+		.bestMove = -1,
+		.score = 0,
+		.depth = 0,
+		.nodes = 0,
+		.elapsedNs = 0,
+		.solved = true
+	};
+
+	if (BoardLastMoveWon(board) || BoardIsFull(board))
+		return result;
+
+	if (limits.threatNodes != 0)
+	{
+		thread_local ThreatSolver solver;
+		ThreatSolverInit(solver, board.width, board.height, board.winLength);
+
+		ThreatResult threats = ThreatSolve(solver, board, ThreatFoursAndThrees, limits.threatNodes);
+		if (threats.win)
+		{
+			//a line that ends in a double threat needs one more move to finish than the solver counts,
+			//so unless the first move wins outright the distance is the longest the win can take
+			BoardPlay(board, threats.move);
+			int plies = BoardLastMoveWon(board) ? 1 : 2 * threats.length + 1;
+			BoardUndo(board);
+
+			result.bestMove = threats.move;
+			result.score = WinScore - plies;
+			result.depth = plies;
+			result.nodes = threats.nodes;
+			result.elapsedNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+			//the forced win is the search's one and final result, so it's reported like a completed depth would be
+			if (limits.onInfo != nullptr)
+			{
+				SearchInfo info =
+				{
+					.depth = result.depth,
+					.score = result.score,
+					.bestMove = result.bestMove,
+					.nodes = result.nodes,
+					.elapsedNs = result.elapsedNs
+				};
+				limits.onInfo(info, limits.infoContext);
+			}
+			return result;
+		}
+	}
+
+	SearchContext context =
+	{
+		.board = &board,
+		.table = table,
+		.stop = stop,
+		.evaluate = limits.evaluate != nullptr ? limits.evaluate : EvaluateLines,
+		.nodes = 0,
+		.maxNodes = limits.maxNodes,
+		.deadline = startTime + std::chrono::nanoseconds(limits.maxTimeNs),
+		.hasDeadline = limits.maxTimeNs > 0,
+		.aborted = false
+	};
+
+	int16_t moves[MaxBoardCells];
+	int moveCount = GenerateMoves(board, moves);
+
+	if (limits.seed != 0)
+	{
+		uint64_t state = limits.seed;
+		for (int i = moveCount - 1; i > 0; i--)
+		{
+			int j = (int)(SplitMix64(state) % (uint64_t)(i + 1));
+			int16_t swap = moves[i];
+			moves[i] = moves[j];
+			moves[j] = swap;
+		}
+	}
+
+	result.bestMove = moves[0];
+	result.solved = false;
+
+	int emptyCells = BoardCellCount(board) - board.moveCount;
+	int maxDepth = limits.maxDepth < emptyCells ? limits.maxDepth : emptyCells;
+
+	for (int depth = 1; depth <= maxDepth; depth++)
+	{
+		int alpha = -WinScore - 1;
+		int beta = WinScore + 1;
+		int bestMove = moves[0];
+
+		for (int i = 0; i < moveCount; i++)
+		{
+			BoardPlay(board, moves[i]);
+			int score = -Negamax(context, depth - 1, -beta, -alpha, 1);
+			BoardUndo(board);
+
+			if (context.aborted)
+				break;
+
+			if (score > alpha)
+			{
+				alpha = score;
+				bestMove = moves[i];
+			}
+		}
+
+		if (context.aborted)
+			break;
+
+		//keep the best move at the front for the next iteration
+		for (int i = 0; i < moveCount; i++)
+		{
+			if (moves[i] == bestMove)
+			{
+				for (; i > 0; i--)
+					moves[i] = moves[i - 1];
+				moves[0] = (int16_t)bestMove;
+				break;
+			}
+		}
+
+		result.bestMove = bestMove;
+		result.score = alpha;
+		result.depth = depth;
+		result.solved = depth == emptyCells || alpha > DecisiveScore || alpha < -DecisiveScore;
+
+		if (limits.onInfo != nullptr)
+		{
+			SearchInfo info =
+			{
+				.depth = depth,
+				.score = alpha,
+				.bestMove = bestMove,
+				.nodes = context.nodes,
+				.elapsedNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count()
+			};
+			limits.onInfo(info, limits.infoContext);
+		}
+
+		if (result.solved)
+			break;
+	}
+
+	result.nodes = context.nodes;
+	result.elapsedNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	return result;
+}
@@ -0,0 +1,336 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//k in a row on an unbounded plane. stones live in 8x8 tiles, found through an open addressing table keyed by tile
+//coordinates, so a game costs one tile per 64 cells it reaches into and nothing per stone.
+//every tile also keeps which of its empty cells are near a stone, so the moves worth looking at never need a scan
+
+constexpr int SparseTileShift = 3;
+constexpr int SparseTileSize = 1 << SparseTileShift;
+
+//how far from a stone a cell can be and still be a candidate move
+constexpr int SparseMaxRadius = SparseTileSize - 1;
+
+struct SparseTile
+{
+	int32_t tileX;
+	int32_t tileY;
+	//bit y * 8 + x, indexed by piece - 1
+	uint64_t stones[2];
+	//empty cells with at least one stone within the radius
+	uint64_t candidates;
+	//stones within the radius of each cell
+	uint8_t nearby[SparseTileSize * SparseTileSize];
+};
+
+struct SparseMove
+{
+	int32_t x;
+	int32_t y;
+};
+
+struct SparseBoard
+{
+	int winLength;
+	int radius;
+	int8_t toMove;
+	uint64_t hash;
+
+	//tiles are never removed, undoing back to an empty board leaves them empty and ready for reuse
+	std::vector<SparseTile> tiles;
+	//index + 1 into tiles, 0 for an empty slot, kept at most half full
+	std::vector<uint32_t> slots;
+	uint32_t slotMask;
+
+	std::vector<SparseMove> moves;
+};
+
+[[nodiscard]]
+constexpr uint64_t SparseMix(uint64_t z) noexcept
+{
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+[[nodiscard]]
+constexpr uint64_t SparsePack(int32_t x, int32_t y) noexcept
+{
+	return ((uint64_t)(uint32_t)x << 32) | (uint32_t)y;
+}
+
+//there's no end to the cells to give each its own key from a table, so they're hashed from the coordinates instead
+[[nodiscard]]
+constexpr uint64_t SparseZobristKey(int32_t x, int32_t y, int8_t piece) noexcept
+{
+	return SparseMix(SparsePack(x, y) * 0x9E3779B97F4A7C15ull + (uint64_t)piece);
+}
+
+//expectedStones sizes everything up front so a game of that length never reallocates
+inline void SparseInit(SparseBoard& board, int winLength, int radius = 2, int8_t firstPiece = PieceX, size_t expectedStones = 256)
+{
+	board.winLength = winLength;
+	board.radius = radius < 1 ? 1 : radius > SparseMaxRadius ? SparseMaxRadius : radius;
+	board.toMove = firstPiece;
+	board.hash = firstPiece == PieceO ? ZobristSideKey : 0;
+
+	//a stone's neighbourhood touches up to 4 tiles, but stones in a game mostly share them
+	size_t expectedTiles = expectedStones / 4 + 16;
+	size_t slotCount = 64;
+	while (slotCount < expectedTiles * 2)
+		slotCount *= 2;
+
+	board.tiles.clear();
+	board.tiles.reserve(expectedTiles);
+	board.slots.assign(slotCount, 0);
+	board.slotMask = (uint32_t)slotCount - 1;
+
+	board.moves.clear();
+	board.moves.reserve(expectedStones);
+}
+
+[[nodiscard]]
+inline size_t SparseSlotFor(const SparseBoard& board, int32_t tileX, int32_t tileY) noexcept
+{
+	return (size_t)(SparseMix(SparsePack(tileX, tileY)) & board.slotMask);
+}
+
+[[nodiscard]]
+inline const SparseTile* SparseFindTile(const SparseBoard& board, int32_t tileX, int32_t tileY) noexcept
+{
+	for (size_t slot = SparseSlotFor(board, tileX, tileY);; slot = (slot + 1) & board.slotMask)
+	{
+		uint32_t index = board.slots[slot];
+		if (index == 0)
+			return nullptr;
+
+		const SparseTile& tile = board.tiles[index - 1];
+		if (tile.tileX == tileX && tile.tileY == tileY)
+			return &tile;
+	}
+}
+
+inline void SparseGrowSlots(SparseBoard& board)
+{
+	board.slots.assign(board.slots.size() * 2, 0);
+	board.slotMask = (uint32_t)board.slots.size() - 1;
+
+	for (size_t i = 0; i < board.tiles.size(); i++)
+	{
+		size_t slot = SparseSlotFor(board, board.tiles[i].tileX, board.tiles[i].tileY);
+		while (board.slots[slot] != 0)
+			slot = (slot + 1) & board.slotMask;
+		board.slots[slot] = (uint32_t)i + 1;
+	}
+}
+
+//finds the tile or adds an empty one, the reference is good until the next tile is added
+[[nodiscard]]
+inline SparseTile& SparseTileAt(SparseBoard& board, int32_t tileX, int32_t tileY)
+{
+	size_t slot = SparseSlotFor(board, tileX, tileY);
+	for (;; slot = (slot + 1) & board.slotMask)
+	{
+		uint32_t index = board.slots[slot];
+		if (index == 0)
+			break;
+
+		SparseTile& tile = board.tiles[index - 1];
+		if (tile.tileX == tileX && tile.tileY == tileY)
+			return tile;
+	}
+
+	board.tiles.push_back(SparseTile{ .tileX = tileX, .tileY = tileY, .stones = {}, .candidates = 0, .nearby = {} });
+	board.slots[slot] = (uint32_t)board.tiles.size();
+
+	if (board.tiles.size() * 2 > board.slots.size())
+		SparseGrowSlots(board);
+
+	return board.tiles.back();
+}
+
+[[nodiscard]]
+constexpr int SparseBit(int32_t x, int32_t y) noexcept
+{
+	return (y & (SparseTileSize - 1)) * SparseTileSize + (x & (SparseTileSize - 1));
+}
+
+[[nodiscard]]
+inline int8_t SparsePieceAt(const SparseBoard& board, int32_t x, int32_t y) noexcept
+{
+	const SparseTile* tile = SparseFindTile(board, x >> SparseTileShift, y >> SparseTileShift);
+	if (tile == nullptr)
+		return PieceNone;
+
+	uint64_t bit = 1ull << SparseBit(x, y);
+	return (tile->stones[0] & bit) != 0 ? PieceO : (tile->stones[1] & bit) != 0 ? PieceX : PieceNone;
+}
+
+[[nodiscard]]
+inline int SparseMoveCount(const SparseBoard& board) noexcept
+{
+	return (int)board.moves.size();
+}
+
+//adds delta to the nearby count of every cell within the radius of (x, y), a tile at a time
+inline void SparseTouchNeighbourhood(SparseBoard& board, int32_t x, int32_t y, int delta)
+{
+	int32_t left = x - board.radius;
+	int32_t right = x + board.radius;
+	int32_t bottom = y - board.radius;
+	int32_t top = y + board.radius;
+
+	for (int32_t tileY = bottom >> SparseTileShift; tileY <= top >> SparseTileShift; tileY++)
+	{
+		for (int32_t tileX = left >> SparseTileShift; tileX <= right >> SparseTileShift; tileX++)
+		{
+			SparseTile& tile = SparseTileAt(board, tileX, tileY);
+			uint64_t occupied = tile.stones[0] | tile.stones[1];
+
+			int32_t startX = tileX * SparseTileSize;
+			int32_t startY = tileY * SparseTileSize;
+			int fromX = left > startX ? left - startX : 0;
+			int toX = right < startX + SparseTileSize - 1 ? right - startX : SparseTileSize - 1;
+			int fromY = bottom > startY ? bottom - startY : 0;
+			int toY = top < startY + SparseTileSize - 1 ? top - startY : SparseTileSize - 1;
+
+			for (int cellY = fromY; cellY <= toY; cellY++)
+			{
+				for (int cellX = fromX; cellX <= toX; cellX++)
+				{
+					int bit = cellY * SparseTileSize + cellX;
+					tile.nearby[bit] = (uint8_t)(tile.nearby[bit] + delta);
+
+					uint64_t mask = 1ull << bit;
+					if (tile.nearby[bit] != 0 && (occupied & mask) == 0)
+						tile.candidates |= mask;
+					else
+						tile.candidates &= ~mask;
+				}
+			}
+		}
+	}
+}
+
+//the cell has to be empty
+inline void SparsePlay(SparseBoard& board, int32_t x, int32_t y)
+{
+	SparseTile& tile = SparseTileAt(board, x >> SparseTileShift, y >> SparseTileShift);
+	uint64_t mask = 1ull << SparseBit(x, y);
+	tile.stones[board.toMove - 1] |= mask;
+	tile.candidates &= ~mask;
+
+	SparseTouchNeighbourhood(board, x, y, 1);
+
+	board.hash ^= SparseZobristKey(x, y, board.toMove) ^ ZobristSideKey;
+	board.moves.push_back(SparseMove{ .x = x, .y = y });
+	board.toMove = OtherPiece(board.toMove);
+}
+
+inline void SparseUndo(SparseBoard& board) noexcept
+{
+	SparseMove move = board.moves.back();
+	board.moves.pop_back();
+	board.toMove = OtherPiece(board.toMove);
+	board.hash ^= SparseZobristKey(move.x, move.y, board.toMove) ^ ZobristSideKey;
+
+	//every tile involved already exists, so nothing here can allocate
+	SparseTile& tile = SparseTileAt(board, move.x >> SparseTileShift, move.y >> SparseTileShift);
+	tile.stones[board.toMove - 1] &= ~(1ull << SparseBit(move.x, move.y));
+
+	SparseTouchNeighbourhood(board, move.x, move.y, -1);
+}
+
+//stones of piece in a row from (x, y) along (dx, dy), not counting (x, y) itself and stopping at limit
+[[nodiscard]]
+inline int SparseRayLength(const SparseBoard& board, int32_t x, int32_t y, int dx, int dy, int8_t piece, int limit) noexcept
+{
+	//consecutive cells are mostly in the same tile, so it's only looked up again on crossing into the next one
+	const SparseTile* tile = nullptr;
+	int32_t tileX = 0;
+	int32_t tileY = 0;
+	bool found = false;
+
+	int length = 0;
+	while (length < limit)
+	{
+		x += dx;
+		y += dy;
+
+		if (!found || x >> SparseTileShift != tileX || y >> SparseTileShift != tileY)
+		{
+			tileX = x >> SparseTileShift;
+			tileY = y >> SparseTileShift;
+			tile = SparseFindTile(board, tileX, tileY);
+			found = true;
+		}
+
+		if (tile == nullptr || (tile->stones[piece - 1] & (1ull << SparseBit(x, y))) == 0)
+			break;
+
+		length++;
+	}
+
+	return length;
+}
+
+//only the 4 lines through the stone just placed can have been completed by it, and only winLength - 1 cells each way matter
+[[nodiscard]]
+inline bool SparseIsWinningMove(const SparseBoard& board, int32_t x, int32_t y) noexcept
+{
+	int8_t piece = SparsePieceAt(board, x, y);
+	if (piece == PieceNone)
+		return false;
+
+	for (const auto& direction : BoardDirections)
+	{
+		int forward = SparseRayLength(board, x, y, direction[0], direction[1], piece, board.winLength - 1);
+		int backward = SparseRayLength(board, x, y, -direction[0], -direction[1], piece, board.winLength - 1 - forward);
+		if (1 + forward + backward >= board.winLength)
+			return true;
+	}
+	return false;
+}
+
+[[nodiscard]]
+inline bool SparseLastMoveWon(const SparseBoard& board) noexcept
+{
+	return !board.moves.empty() && SparseIsWinningMove(board, board.moves.back().x, board.moves.back().y);
+}
+
+//every empty cell within the radius of a stone, or the origin on an empty board. moves keeps its capacity between calls
+inline void SparseGenerateMoves(const SparseBoard& board, std::vector<SparseMove>& moves)
+{
+	moves.clear();
+
+	if (board.moves.empty())
+	{
+		moves.push_back(SparseMove{ .x = 0, .y = 0 });
+		return;
+	}
+
+	for (const SparseTile& tile : board.tiles)
+	{
+		for (uint64_t candidates = tile.candidates; candidates != 0; candidates &= candidates - 1)
+		{
+			int bit = std::countr_zero(candidates);
+			moves.push_back(SparseMove
+			{
+				.x = tile.tileX * SparseTileSize + (bit & (SparseTileSize - 1)),
+				.y = tile.tileY * SparseTileSize + (bit >> SparseTileShift)
+			});
+		}
+	}
+}
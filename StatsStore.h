@@ -0,0 +1,619 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+//every player's results, kept across restarts. each update is a fixed size record appended to a write-ahead log,
+//and one background thread writes and syncs whatever has piled up since its last sync, so any number of updates share a sync.
+//once the log grows past a limit the whole state is written to a snapshot and the log starts over
+
+constexpr uint32_t StatsMagic = 0x53544154;
+constexpr uint32_t StatsVersion = 1;
+
+constexpr int StatsNameLength = 24;
+
+enum StatsRecordKind : uint32_t
+{
+	StatsRegister = 1,
+	StatsPlayerWin,
+	StatsCPUWin,
+	StatsTie
+};
+
+struct StatsRecord
+{
+	//crc32 of everything after it
+	uint32_t checksum;
+	uint32_t kind;
+	uint64_t sequence;
+	uint32_t player;
+	int32_t winType;
+	char name[StatsNameLength];
+};
+
+static_assert(sizeof(StatsRecord) == 48, "log records are written as they are in memory");
+
+struct PlayerStats
+{
+	char name[StatsNameLength];
+	uint64_t playerScore;
+	uint64_t CPUScore;
+	uint64_t ties;
+	//indexed by the winType of the winning line, 1 to 8
+	uint64_t playerWins[9];
+	uint64_t CPUWins[9];
+};
+
+struct StatsCounters
+{
+	uint64_t recordsWritten = 0;
+	uint64_t syncs = 0;
+	uint64_t snapshots = 0;
+	//batches that didn't make it to disk and were put back to be written again
+	uint64_t failedWrites = 0;
+	//what opening found
+	uint64_t recoveredRecords = 0;
+	uint64_t discardedBytes = 0;
+	int64_t recoveryNs = 0;
+};
+
+struct StatsStore;
+inline void StatsClose(StatsStore& store) noexcept;
+
+struct StatsStore
+{
+	char walPath[1024];
+	char snapshotPath[1024];
+	FILE* wal = nullptr;
+
+	std::mutex mutex;
+	std::condition_variable flushNeeded;
+	std::condition_variable flushed;
+	std::thread flusher;
+	bool stopping = false;
+	bool open = false;
+
+	std::vector<PlayerStats> players;
+	std::unordered_map<std::string, uint32_t> playerIds;
+
+	//appended but not yet handed to the flusher, and the batch the flusher is writing
+	std::vector<StatsRecord> pending;
+	std::vector<StatsRecord> writing;
+
+	uint64_t lastSequence = 0;
+	uint64_t durableSequence = 0;
+	uint64_t snapshotSequence = 0;
+	uint64_t walBytes = 0;
+	uint64_t snapshotThreshold = 64ull * 1024 * 1024;
+	bool snapshotRequested = false;
+	//the last batch failed, set until one gets through
+	bool writeFailed = false;
+
+	StatsCounters counters;
+
+	~StatsStore()
+	{
+		StatsClose(*this);
+	}
+};
+
+inline constexpr std::array<uint32_t, 256> StatsCrcTable = []
+{
+	std::array<uint32_t, 256> table = {};
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+		table[i] = crc;
+	}
+	return table;
+}();
+
+[[nodiscard]]
+inline uint32_t StatsCrc(const void* data, size_t length, uint32_t crc = 0) noexcept
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = StatsCrcTable[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+[[nodiscard]]
+inline uint32_t StatsRecordChecksum(const StatsRecord& record) noexcept
+{
+	return StatsCrc((const uint8_t*)&record + sizeof(record.checksum), sizeof(record) - sizeof(record.checksum));
+}
+
+//makes everything written to the file so far survive a power cut
+[[nodiscard]]
+inline bool StatsSync(FILE* file) noexcept
+{
+	if (fflush(file) != 0)
+		return false;
+#ifdef _WIN32
+	return _commit(_fileno(file)) == 0;
+#else
+	return fsync(fileno(file)) == 0;
+#endif
+}
+
+//cuts the file back to length bytes
+[[nodiscard]]
+inline bool StatsTruncate(FILE* file, uint64_t length) noexcept
+{
+	if (fflush(file) != 0)
+		return false;
+#ifdef _WIN32
+	return _chsize_s(_fileno(file), (__int64)length) == 0;
+#else
+	return ftruncate(fileno(file), (off_t)length) == 0;
+#endif
+}
+
+//applies a record to the in memory state, false when it makes no sense
+inline bool StatsApply(StatsStore& store, const StatsRecord& record) noexcept
+{
+	if (record.kind == StatsRegister)
+	{
+		if (record.player != store.players.size())
+			return false;
+
+		PlayerStats player = {};
+		memcpy(player.name, record.name, StatsNameLength);
+		player.name[StatsNameLength - 1] = '\0';
+		store.players.push_back(player);
+		store.playerIds.emplace(player.name, record.player);
+		return true;
+	}
+
+	if (record.player >= store.players.size() || record.winType < 0 || record.winType > 8)
+		return false;
+
+	PlayerStats& player = store.players[record.player];
+
+	switch (record.kind)
+	{
+	case StatsPlayerWin:
+		player.playerScore++;
+		player.playerWins[record.winType]++;
+		return true;
+	case StatsCPUWin:
+		player.CPUScore++;
+		player.CPUWins[record.winType]++;
+		return true;
+	case StatsTie:
+		player.ties++;
+		return true;
+	default:
+		return false;
+	}
+}
+
+struct StatsSnapshotHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t sequence;
+	uint64_t playerCount;
+	uint32_t checksum;
+	uint32_t padding;
+};
+
+[[nodiscard]]
+inline bool StatsWriteSnapshot(const char* path, const std::vector<PlayerStats>& players, uint64_t sequence) noexcept
+{
+	char temporaryPath[1040];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+
+	FILE* file = fopen(temporaryPath, "wb");
+	if (file == nullptr)
+		return false;
+
+	StatsSnapshotHeader header =
+	{
+		.magic = StatsMagic,
+		.version = StatsVersion,
+		.sequence = sequence,
+		.playerCount = players.size(),
+		.checksum = StatsCrc(players.data(), players.size() * sizeof(PlayerStats)),
+		.padding = 0
+	};
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(players.data(), sizeof(PlayerStats), players.size(), file) == players.size() &&
+		StatsSync(file);
+
+	ok = fclose(file) == 0 && ok;
+
+	//replace the old snapshot only once the new one is complete
+	if (ok)
+	{
+		remove(path);
+		ok = rename(temporaryPath, path) == 0;
+	}
+
+	return ok;
+}
+
+[[nodiscard]]
+inline bool StatsReadSnapshot(const char* path, std::vector<PlayerStats>& players, uint64_t& sequence) noexcept
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr)
+		return false;
+
+	StatsSnapshotHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == StatsMagic &&
+		header.version == StatsVersion &&
+		header.playerCount < (1ull << 32);
+
+	//the player count has to match the file's size, and the players their checksum, before anything is allocated for them
+	if (ok)
+	{
+		ok = fseek(file, 0, SEEK_END) == 0 &&
+			(uint64_t)ftell(file) == sizeof(header) + header.playerCount * sizeof(PlayerStats) &&
+			fseek(file, sizeof(header), SEEK_SET) == 0;
+	}
+
+	if (ok)
+	{
+		PlayerStats chunk[64];
+		uint32_t crc = 0;
+		for (uint64_t left = header.playerCount; ok && left != 0;)
+		{
+			size_t count = left < 64 ? (size_t)left : 64;
+			ok = fread(chunk, sizeof(PlayerStats), count, file) == count;
+			crc = StatsCrc(chunk, count * sizeof(PlayerStats), crc);
+			left -= count;
+		}
+
+		ok = ok && crc == header.checksum && fseek(file, sizeof(header), SEEK_SET) == 0;
+	}
+
+	if (ok)
+	{
+		players.resize((size_t)header.playerCount);
+		ok = fread(players.data(), sizeof(PlayerStats), players.size(), file) == players.size() &&
+			StatsCrc(players.data(), players.size() * sizeof(PlayerStats)) == header.checksum;
+	}
+
+	fclose(file);
+
+	if (ok)
+		sequence = header.sequence;
+	else
+		players.clear();
+
+	return ok;
+}
+
+//writes out batches until asked to stop, snapshotting when the log has grown too long
+inline void StatsFlusher(StatsStore& store) noexcept
+{
+	std::unique_lock<std::mutex> lock(store.mutex);
+
+	while (true)
+	{
+		//after a failure the batch is already back in pending, so give whatever went wrong a moment before trying again
+		if (store.writeFailed && !store.stopping)
+			store.flushNeeded.wait_for(lock, std::chrono::milliseconds(100));
+
+		store.flushNeeded.wait(lock, [&]() noexcept { return store.stopping || !store.pending.empty() || store.snapshotRequested; });
+
+		if (store.pending.empty() && !store.snapshotRequested && store.stopping)
+			break;
+
+		store.writing.swap(store.pending);
+		uint64_t batchSequence = store.lastSequence;
+		uint64_t goodBytes = store.walBytes;
+
+		bool snapshot = store.snapshotRequested || store.walBytes + store.writing.size() * sizeof(StatsRecord) >= store.snapshotThreshold;
+		std::vector<PlayerStats> players;
+		if (snapshot)
+			players = store.players;
+		store.snapshotRequested = false;
+
+		lock.unlock();
+
+		bool written = fwrite(store.writing.data(), sizeof(StatsRecord), store.writing.size(), store.wal) == store.writing.size() &&
+			StatsSync(store.wal);
+
+		//whatever part of the batch reached the file is cut off again, and the file reopened so nothing still
+		//buffered from the failed write follows it, otherwise replay would stop at the gap on the next open
+		if (!written)
+		{
+			fclose(store.wal);
+			store.wal = nullptr;
+
+			if (FILE* file = fopen(store.walPath, "r+b"))
+			{
+				bool truncated = StatsTruncate(file, goodBytes) && StatsSync(file);
+				fclose(file);
+				if (truncated)
+					store.wal = fopen(store.walPath, "ab");
+			}
+		}
+
+		//the snapshot holds every record up to batchSequence, so the log can start over once it's durable
+		bool compacted = snapshot && StatsWriteSnapshot(store.snapshotPath, players, batchSequence);
+		if (compacted)
+		{
+			if (store.wal != nullptr)
+				fclose(store.wal);
+			store.wal = fopen(store.walPath, "wb");
+			compacted = store.wal != nullptr && StatsSync(store.wal);
+		}
+
+		lock.lock();
+
+		if (written || compacted)
+		{
+			store.counters.recordsWritten += store.writing.size();
+			store.counters.syncs++;
+			store.durableSequence = batchSequence;
+			store.walBytes += store.writing.size() * sizeof(StatsRecord);
+		}
+
+		if (compacted)
+		{
+			store.counters.snapshots++;
+			store.snapshotSequence = batchSequence;
+			store.walBytes = 0;
+		}
+
+		//a batch that isn't on disk goes back in front of anything appended since, and durableSequence stays
+		//where it was, so nobody is told a record is durable that the next open wouldn't find
+		store.writeFailed = !written && !compacted;
+		if (store.writeFailed)
+		{
+			store.counters.failedWrites++;
+			store.writing.insert(store.writing.end(), store.pending.begin(), store.pending.end());
+			store.pending.swap(store.writing);
+			store.snapshotRequested |= snapshot;
+		}
+
+		store.writing.clear();
+		store.flushed.notify_all();
+
+		//closing can't wait on a disk that keeps failing, what's left stays out of the log and was never reported durable
+		if (store.wal == nullptr || (store.writeFailed && store.stopping))
+			break;
+	}
+}
+
+//loads the snapshot, replays the log after it up to the first torn or corrupt record, and starts the flusher.
+//path is a prefix, the files are path.wal and path.snapshot
+[[nodiscard]]
+inline bool StatsOpen(StatsStore& store, const char* path) noexcept
+{
+	auto start = std::chrono::steady_clock::now();
+
+	snprintf(store.walPath, sizeof(store.walPath), "%s.wal", path);
+	snprintf(store.snapshotPath, sizeof(store.snapshotPath), "%s.snapshot", path);
+
+	store.players.clear();
+	store.playerIds.clear();
+	store.counters = StatsCounters{};
+
+	uint64_t sequence = 0;
+	if (!StatsReadSnapshot(store.snapshotPath, store.players, sequence))
+	{
+		//a crash between removing the old snapshot and renaming the new one leaves only the new one
+		char temporaryPath[1040];
+		snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", store.snapshotPath);
+		if (!StatsReadSnapshot(temporaryPath, store.players, sequence))
+			sequence = 0;
+	}
+
+	for (uint32_t i = 0; i < store.players.size(); i++)
+		store.playerIds.emplace(store.players[i].name, i);
+
+	store.snapshotSequence = sequence;
+	store.lastSequence = sequence;
+
+	uint64_t validBytes = 0;
+	uint64_t fileBytes = 0;
+
+	if (FILE* file = fopen(store.walPath, "rb"))
+	{
+		std::vector<StatsRecord> block(1 << 14);
+		bool intact = true;
+
+		while (intact)
+		{
+			size_t count = fread(block.data(), sizeof(StatsRecord), block.size(), file);
+			fileBytes += count * sizeof(StatsRecord);
+
+			for (size_t i = 0; i < count && intact; i++)
+			{
+				const StatsRecord& record = block[i];
+				intact = record.checksum == StatsRecordChecksum(record) && record.sequence > 0;
+
+				//records the snapshot already holds were written before the log was reset, or just before a snapshot
+				if (intact && record.sequence > store.lastSequence)
+				{
+					intact = record.sequence == store.lastSequence + 1 && StatsApply(store, record);
+					if (intact)
+					{
+						store.lastSequence = record.sequence;
+						store.counters.recoveredRecords++;
+					}
+				}
+
+				if (intact)
+					validBytes += sizeof(StatsRecord);
+			}
+
+			if (count < block.size())
+			{
+				//a partial record at the end is a torn write
+				fseek(file, 0, SEEK_END);
+				fileBytes = (uint64_t)ftell(file);
+				break;
+			}
+		}
+
+		fclose(file);
+	}
+
+	store.counters.discardedBytes = fileBytes - validBytes;
+
+	//cut off whatever followed the last good record so new records don't land behind garbage
+	if (store.counters.discardedBytes != 0)
+	{
+		std::vector<StatsRecord> kept(validBytes / sizeof(StatsRecord));
+		FILE* file = fopen(store.walPath, "rb");
+		bool ok = file != nullptr && fread(kept.data(), sizeof(StatsRecord), kept.size(), file) == kept.size();
+		if (file != nullptr)
+			fclose(file);
+
+		file = ok ? fopen(store.walPath, "wb") : nullptr;
+		ok = file != nullptr && fwrite(kept.data(), sizeof(StatsRecord), kept.size(), file) == kept.size() && StatsSync(file);
+		if (file != nullptr)
+			fclose(file);
+
+		if (!ok)
+			return false;
+	}
+
+	store.wal = fopen(store.walPath, "ab");
+	if (store.wal == nullptr)
+		return false;
+
+	store.walBytes = validBytes;
+	store.durableSequence = store.lastSequence;
+	store.stopping = false;
+	store.open = true;
+	store.flusher = std::thread(StatsFlusher, std::ref(store));
+
+	store.counters.recoveryNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+//writes out everything appended so far and stops the flusher
+inline void StatsClose(StatsStore& store) noexcept
+{
+	if (!store.open)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(store.mutex);
+		store.stopping = true;
+	}
+	store.flushNeeded.notify_one();
+	store.flusher.join();
+
+	if (store.wal != nullptr)
+		fclose(store.wal);
+	store.wal = nullptr;
+	store.open = false;
+}
+
+//caller holds the mutex
+inline uint64_t StatsAppend(StatsStore& store, StatsRecord& record) noexcept
+{
+	record.sequence = ++store.lastSequence;
+	record.checksum = StatsRecordChecksum(record);
+	StatsApply(store, record);
+
+	bool wake = store.pending.empty();
+	store.pending.push_back(record);
+	if (wake)
+		store.flushNeeded.notify_one();
+
+	return record.sequence;
+}
+
+//the id of the player with this name, registering them the first time
+[[nodiscard]]
+inline uint32_t StatsPlayer(StatsStore& store, const char* name) noexcept
+{
+	char truncated[StatsNameLength] = {};
+	for (int i = 0; i < StatsNameLength - 1 && name[i] != '\0'; i++)
+		truncated[i] = name[i];
+
+	std::lock_guard<std::mutex> lock(store.mutex);
+
+	auto found = store.playerIds.find(truncated);
+	if (found != store.playerIds.end())
+		return found->second;
+
+	StatsRecord record =
+	{
+		.checksum = 0,
+		.kind = StatsRegister,
+		.sequence = 0,
+		.player = (uint32_t)store.players.size(),
+		.winType = 0,
+		.name = {}
+	};
+	memcpy(record.name, truncated, StatsNameLength);
+	StatsAppend(store, record);
+	return record.player;
+}
+
+//kind is StatsPlayerWin, StatsCPUWin or StatsTie. returns the sequence number to wait on for durability
+inline uint64_t StatsRecordResult(StatsStore& store, uint32_t player, StatsRecordKind kind, int winType) noexcept
+{
+	StatsRecord record =
+	{
+		.checksum = 0,
+		.kind = kind,
+		.sequence = 0,
+		.player = player,
+		.winType = winType,
+		.name = {}
+	};
+
+	std::lock_guard<std::mutex> lock(store.mutex);
+	return StatsAppend(store, record);
+}
+
+//blocks until the record with this sequence number is on disk. false if a write failed before it got there,
+//the flusher keeps retrying, so waiting again can still succeed
+[[nodiscard]]
+inline bool StatsWaitDurable(StatsStore& store, uint64_t sequence) noexcept
+{
+	std::unique_lock<std::mutex> lock(store.mutex);
+	store.flushed.wait(lock, [&]() noexcept { return store.durableSequence >= sequence || store.writeFailed || store.wal == nullptr; });
+	return store.durableSequence >= sequence;
+}
+
+//writes a snapshot with the next batch and starts the log over
+inline void StatsCompact(StatsStore& store) noexcept
+{
+	std::lock_guard<std::mutex> lock(store.mutex);
+	store.snapshotRequested = true;
+	store.flushNeeded.notify_one();
+}
+
+[[nodiscard]]
+inline PlayerStats StatsGet(StatsStore& store, uint32_t player) noexcept
+{
+	std::lock_guard<std::mutex> lock(store.mutex);
+	return player < store.players.size() ? store.players[player] : PlayerStats{};
+}
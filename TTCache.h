@@ -0,0 +1,237 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Search.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//a transposition table kept in a file between runs. the file is the entries exactly as they are in memory behind a header,
+//so loading it is mapping it copy-on-write: nothing is read until a search touches it, and writes stay private to the process
+
+constexpr char TTCacheMagic[8] = { 'T', 'T', 'C', 'A', 'C', 'H', 'E', 0 };
+
+//bump whenever the search, the evaluation or the Zobrist keys change what a stored entry means
+constexpr uint32_t TTCacheVersion = 1;
+
+struct TTCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t entrySize;
+	uint64_t entryCount;
+	//keys don't say which board they came from, so entries are only any good on the same one
+	int32_t width;
+	int32_t height;
+	int32_t winLength;
+	uint32_t padding;
+	uint64_t entriesHash;
+	uint64_t reserved;
+	//of everything above it
+	uint64_t headerHash;
+};
+
+static_assert(sizeof(TTCacheHeader) == 64, "the entries after the header stay 16 byte aligned");
+
+//not cryptographic, just cheap enough to run over the whole table at startup and sensitive to any changed bit
+[[nodiscard]]
+inline uint64_t TTCacheHash(const void* data, size_t bytes) noexcept
+{
+	const unsigned char* cursor = (const unsigned char*)data;
+	uint64_t lanes[4] = { 0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull };
+
+	//four independent lanes so the multiplies overlap
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32)
+	{
+		for (int lane = 0; lane < 4; lane++)
+		{
+			uint64_t word;
+			memcpy(&word, cursor + i + lane * 8, 8);
+			lanes[lane] = (lanes[lane] ^ word) * 0xFF51AFD7ED558CCDull;
+			lanes[lane] ^= lanes[lane] >> 29;
+		}
+	}
+
+	uint64_t hash = bytes;
+	for (uint64_t lane : lanes)
+		hash = (hash ^ lane) * 0xC4CEB9FE1A85EC53ull;
+
+	for (; i < bytes; i++)
+		hash = (hash ^ cursor[i]) * 0x100000001B3ull;
+
+	return hash ^ (hash >> 32);
+}
+
+inline void TTCacheUnmap(TranspositionTable& table) noexcept
+{
+#ifdef _WIN32
+	UnmapViewOfFile(table.mapping);
+#else
+	munmap(table.mapping, table.mappingBytes);
+#endif
+
+	table.entries = nullptr;
+	table.mask = 0;
+	table.unmap = nullptr;
+	table.mapping = nullptr;
+	table.mappingBytes = 0;
+}
+
+//writes the table for the board it was searched on, replacing the old file only once the new one is complete.
+//a mapped table is copied into memory first, since a file that is mapped can't be replaced everywhere
+[[nodiscard]]
+inline bool TTCacheSave(TranspositionTable& table, const char* path, int width, int height, int winLength)
+{
+	size_t size = TTSize(table);
+	if (size == 0)
+		return false;
+
+	if (table.unmap != nullptr)
+	{
+		std::vector<TTEntry> storage(table.entries, table.entries + size);
+		table.unmap(table);
+		table.storage.swap(storage);
+		table.entries = table.storage.data();
+		table.mask = size - 1;
+	}
+
+	char temporaryPath[1040];
+	snprintf(temporaryPath, sizeof(temporaryPath), "%s.tmp", path);
+
+	FILE* file = fopen(temporaryPath, "wb");
+	if (file == nullptr)
+		return false;
+
+	TTCacheHeader header =
+	{
+		.magic = {},
+		.version = TTCacheVersion,
+		.entrySize = sizeof(TTEntry),
+		.entryCount = size,
+		.width = width,
+		.height = height,
+		.winLength = winLength,
+		.padding = 0,
+		.entriesHash = TTCacheHash(table.entries, size * sizeof(TTEntry)),
+		.reserved = 0,
+		.headerHash = 0
+	};
+	memcpy(header.magic, TTCacheMagic, sizeof(header.magic));
+	header.headerHash = TTCacheHash(&header, offsetof(TTCacheHeader, headerHash));
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(table.entries, sizeof(TTEntry), size, file) == size;
+
+	ok = fclose(file) == 0 && ok;
+
+	if (ok)
+	{
+		remove(path);
+		ok = rename(temporaryPath, path) == 0;
+	}
+
+	return ok;
+}
+
+//swaps the table for the one in the file if it was saved for the same board by the same version, and leaves it alone otherwise.
+//verifyEntries hashes every entry before accepting them, which reads the whole file up front; without it a damaged entry
+//can only cost a bad move ordering or score, never a crash, since a stored move is only used if it's one of the legal ones
+[[nodiscard]]
+inline bool TTCacheMap(TranspositionTable& table, const char* path, int width, int height, int winLength, bool verifyEntries) noexcept
+{
+	void* view = nullptr;
+	size_t bytes = 0;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = nullptr;
+	if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= (LONGLONG)sizeof(TTCacheHeader))
+		mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	CloseHandle(file);
+
+	if (mapping == nullptr)
+		return false;
+
+	//the view keeps the mapping alive
+	view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (view == nullptr)
+		return false;
+
+	bytes = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	if (fstat(file, &status) == 0 && status.st_size >= (off_t)sizeof(TTCacheHeader))
+	{
+		bytes = (size_t)status.st_size;
+		view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED)
+			view = nullptr;
+	}
+	close(file);
+
+	if (view == nullptr)
+		return false;
+#endif
+
+	const TTCacheHeader& header = *(const TTCacheHeader*)view;
+	TTEntry* entries = (TTEntry*)((char*)view + sizeof(TTCacheHeader));
+
+	bool ok = memcmp(header.magic, TTCacheMagic, sizeof(header.magic)) == 0 &&
+		header.headerHash == TTCacheHash(&header, offsetof(TTCacheHeader, headerHash)) &&
+		header.version == TTCacheVersion &&
+		header.entrySize == sizeof(TTEntry) &&
+		header.width == width &&
+		header.height == height &&
+		header.winLength == winLength &&
+		header.entryCount != 0 &&
+		(header.entryCount & (header.entryCount - 1)) == 0 &&
+		header.entryCount == (bytes - sizeof(TTCacheHeader)) / sizeof(TTEntry) &&
+		bytes == sizeof(TTCacheHeader) + header.entryCount * sizeof(TTEntry) &&
+		(!verifyEntries || header.entriesHash == TTCacheHash(entries, bytes - sizeof(TTCacheHeader)));
+
+	if (!ok)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(view);
+#else
+		munmap(view, bytes);
+#endif
+		return false;
+	}
+
+	TTFree(table);
+	table.entries = entries;
+	table.mask = header.entryCount - 1;
+	table.unmap = TTCacheUnmap;
+	table.mapping = view;
+	table.mappingBytes = bytes;
+
+	return true;
+}
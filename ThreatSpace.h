@@ -0,0 +1,483 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//threat-space search: looks only at sequences where every attacking move is a threat the defender has to answer.
+//a four is a window one stone short of winLength with the rest empty, the defender's reply is forced.
+//a three is a move that sets up a cell completing two fours at once, the defender has a handful of replies and all of them are tried.
+//each new threat has to share a window with an earlier attacking stone of the same sequence, which is what keeps the tree small
+
+enum ThreatMode
+{
+	ThreatFours,
+	ThreatFoursAndThrees
+};
+
+struct ThreatResult
+{
+	bool win;
+	int move;
+	//attacking moves in the forced win, including the last one
+	int length;
+	uint64_t nodes;
+	int64_t elapsedNs;
+};
+
+struct ThreatSolver
+{
+	int width = 0;
+	int height = 0;
+	int winLength = 0;
+	int windowCount = 0;
+	std::vector<int16_t> windowCells;
+	std::vector<int32_t> cellWindowStart;
+	std::vector<int32_t> cellWindows;
+	//stones of each piece in every window, kept up to date move by move
+	std::vector<uint8_t> counts;
+	std::vector<uint32_t> windowStamps;
+	uint32_t stamp = 0;
+
+	Board* board = nullptr;
+	ThreatMode mode = ThreatFours;
+	int8_t attacker = PieceNone;
+	int threeDepth = 0;
+	uint64_t nodes = 0;
+	uint64_t maxNodes = 0;
+	bool aborted = false;
+	//set when some line was cut off by the depth limit, so a deeper pass could still find something
+	bool depthLimited = false;
+	int attackerMoveCount = 0;
+	int16_t attackerMoves[MaxBoardCells];
+};
+
+//builds the window tables, cheap to call again for the same board size
+inline void ThreatSolverInit(ThreatSolver& solver, int width, int height, int winLength)
+{
+	if (solver.width == width && solver.height == height && solver.winLength == winLength)
+		return;
+
+	solver.width = width;
+	solver.height = height;
+	solver.winLength = winLength;
+	solver.windowCells.clear();
+
+	for (const auto& direction : BoardDirections)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			int endY = y + direction[1] * (winLength - 1);
+			if (endY < 0 || endY >= height)
+				continue;
+
+			for (int x = 0; x + direction[0] * (winLength - 1) < width; x++)
+			{
+				for (int i = 0; i < winLength; i++)
+					solver.windowCells.push_back((int16_t)((y + direction[1] * i) * width + x + direction[0] * i));
+			}
+		}
+	}
+
+	solver.windowCount = (int)(solver.windowCells.size() / winLength);
+
+	int cellCount = width * height;
+	solver.cellWindowStart.assign(cellCount + 1, 0);
+	for (int16_t cell : solver.windowCells)
+		solver.cellWindowStart[cell + 1]++;
+	for (int cell = 0; cell < cellCount; cell++)
+		solver.cellWindowStart[cell + 1] += solver.cellWindowStart[cell];
+
+	solver.cellWindows.resize(solver.windowCells.size());
+	std::vector<int32_t> fill(solver.cellWindowStart.begin(), solver.cellWindowStart.end() - 1);
+	for (size_t i = 0; i < solver.windowCells.size(); i++)
+		solver.cellWindows[fill[solver.windowCells[i]]++] = (int32_t)(i / winLength);
+
+	solver.counts.assign(solver.windowCount * 3, 0);
+	solver.windowStamps.assign(solver.windowCount, 0);
+	solver.stamp = 0;
+}
+
+inline void ThreatPlay(ThreatSolver& solver, int cell) noexcept
+{
+	int8_t piece = solver.board->toMove;
+	BoardPlay(*solver.board, cell);
+	for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+		solver.counts[solver.cellWindows[i] * 3 + piece]++;
+}
+
+inline void ThreatUndo(ThreatSolver& solver) noexcept
+{
+	int cell = solver.board->moves[solver.board->moveCount - 1];
+	int8_t piece = solver.board->cells[cell];
+	BoardUndo(*solver.board);
+	for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+		solver.counts[solver.cellWindows[i] * 3 + piece]--;
+}
+
+[[nodiscard]]
+inline int ThreatEmptyCell(const ThreatSolver& solver, int window, int skip = -1) noexcept
+{
+	const int16_t* cells = &solver.windowCells[window * solver.winLength];
+	for (int i = 0; i < solver.winLength; i++)
+	{
+		if (solver.board->cells[cells[i]] == PieceNone && cells[i] != skip)
+			return cells[i];
+	}
+	return -1;
+}
+
+inline void ThreatAddUnique(int16_t* list, int& count, int cell) noexcept
+{
+	for (int i = 0; i < count; i++)
+	{
+		if (list[i] == cell)
+			return;
+	}
+	list[count++] = (int16_t)cell;
+}
+
+//cells where piece would complete a window, looking only at windows through cell, or every window if cell is -1
+inline int ThreatWinningCells(const ThreatSolver& solver, int cell, int8_t piece, int16_t* out, int max) noexcept
+{
+	int count = 0;
+	int8_t other = OtherPiece(piece);
+
+	auto check = [&](int window) noexcept
+	{
+		if (count < max &&
+			solver.counts[window * 3 + piece] == solver.winLength - 1 &&
+			solver.counts[window * 3 + other] == 0)
+			ThreatAddUnique(out, count, ThreatEmptyCell(solver, window));
+	};
+
+	if (cell < 0)
+	{
+		for (int window = 0; window < solver.windowCount; window++)
+			check(window);
+	}
+	else
+	{
+		for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+			check(solver.cellWindows[i]);
+	}
+
+	return count;
+}
+
+//how many different cells piece would threaten to win at after playing the empty cell
+[[nodiscard]]
+inline int ThreatFoursMadeBy(const ThreatSolver& solver, int cell, int8_t piece) noexcept
+{
+	int16_t completions[8];
+	int count = 0;
+	int8_t other = OtherPiece(piece);
+
+	for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1] && count < 8; i++)
+	{
+		int window = solver.cellWindows[i];
+		if (solver.counts[window * 3 + piece] == solver.winLength - 2 && solver.counts[window * 3 + other] == 0)
+			ThreatAddUnique(completions, count, ThreatEmptyCell(solver, window, cell));
+	}
+
+	return count;
+}
+
+//cells next to the attacker's last move where one more stone would make two fours at once, the defender has to deal with all of them
+inline int ThreatDoubleFourCells(const ThreatSolver& solver, int cell, int16_t* out, int max) noexcept
+{
+	int count = 0;
+	int8_t piece = solver.attacker;
+	int8_t other = OtherPiece(piece);
+
+	for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+	{
+		int window = solver.cellWindows[i];
+		if (solver.counts[window * 3 + piece] != solver.winLength - 2 || solver.counts[window * 3 + other] != 0)
+			continue;
+
+		const int16_t* cells = &solver.windowCells[window * solver.winLength];
+		for (int j = 0; j < solver.winLength && count < max; j++)
+		{
+			if (solver.board->cells[cells[j]] == PieceNone && ThreatFoursMadeBy(solver, cells[j], piece) >= 2)
+				ThreatAddUnique(out, count, cells[j]);
+		}
+	}
+
+	return count;
+}
+
+[[nodiscard]]
+inline bool ThreatShouldAbort(ThreatSolver& solver) noexcept
+{
+	if (solver.maxNodes != 0 && solver.nodes >= solver.maxNodes)
+		solver.aborted = true;
+	return solver.aborted;
+}
+
+inline bool ThreatAttack(ThreatSolver& solver, int depth, int lastDefence, int& bestMove) noexcept;
+
+//the attacker just played cell, true if every defence still loses
+inline bool ThreatDefend(ThreatSolver& solver, int depth, int cell) noexcept
+{
+	solver.nodes++;
+
+	int16_t wins[4];
+	int winCount = ThreatWinningCells(solver, cell, solver.attacker, wins, 4);
+
+	if (winCount >= 2)
+		return true;
+
+	int unused;
+
+	if (winCount == 1)
+	{
+		ThreatPlay(solver, wins[0]);
+		bool result = ThreatAttack(solver, depth - 1, wins[0], unused);
+		ThreatUndo(solver);
+		return result;
+	}
+
+	if (solver.mode != ThreatFoursAndThrees || solver.threeDepth <= 0 || depth <= 1)
+		return false;
+
+	int16_t doubleFours[MaxBoardCells];
+	int doubleFourCount = ThreatDoubleFourCells(solver, cell, doubleFours, MaxBoardCells);
+	if (doubleFourCount == 0)
+		return false;
+
+	//a superset of the replies that could matter: the double four cells, the windows they'd complete, and any four of the defender's own
+	int16_t defences[MaxBoardCells];
+	int defenceCount = 0;
+	int8_t defender = OtherPiece(solver.attacker);
+
+	for (int i = 0; i < doubleFourCount; i++)
+	{
+		ThreatAddUnique(defences, defenceCount, doubleFours[i]);
+		for (int32_t j = solver.cellWindowStart[doubleFours[i]]; j < solver.cellWindowStart[doubleFours[i] + 1]; j++)
+		{
+			int window = solver.cellWindows[j];
+			if (solver.counts[window * 3 + solver.attacker] != solver.winLength - 2 || solver.counts[window * 3 + defender] != 0)
+				continue;
+
+			const int16_t* cells = &solver.windowCells[window * solver.winLength];
+			for (int k = 0; k < solver.winLength; k++)
+			{
+				if (solver.board->cells[cells[k]] == PieceNone)
+					ThreatAddUnique(defences, defenceCount, cells[k]);
+			}
+		}
+	}
+
+	for (int window = 0; window < solver.windowCount; window++)
+	{
+		if (solver.counts[window * 3 + defender] != solver.winLength - 2 || solver.counts[window * 3 + solver.attacker] != 0)
+			continue;
+
+		const int16_t* cells = &solver.windowCells[window * solver.winLength];
+		for (int k = 0; k < solver.winLength; k++)
+		{
+			if (solver.board->cells[cells[k]] == PieceNone)
+				ThreatAddUnique(defences, defenceCount, cells[k]);
+		}
+	}
+
+	solver.threeDepth--;
+	bool result = true;
+	for (int i = 0; i < defenceCount && result; i++)
+	{
+		ThreatPlay(solver, defences[i]);
+		result = ThreatAttack(solver, depth - 1, defences[i], unused);
+		ThreatUndo(solver);
+	}
+	solver.threeDepth++;
+
+	return result && !solver.aborted;
+}
+
+//attacker to move, lastDefence is the defender's last stone or -1 at the root
+inline bool ThreatAttack(ThreatSolver& solver, int depth, int lastDefence, int& bestMove) noexcept
+{
+	solver.nodes++;
+
+	if (depth <= 0)
+	{
+		solver.depthLimited = true;
+		return false;
+	}
+
+	if (ThreatShouldAbort(solver))
+		return false;
+
+	int8_t attacker = solver.attacker;
+	int8_t defender = OtherPiece(attacker);
+
+	int16_t wins[4];
+	if (lastDefence < 0 && ThreatWinningCells(solver, -1, attacker, wins, 1) != 0)
+	{
+		bestMove = wins[0];
+		return true;
+	}
+
+	int16_t candidates[MaxBoardCells];
+	int candidateCount = 0;
+
+	int16_t blocks[2];
+	int blockCount = ThreatWinningCells(solver, lastDefence, defender, blocks, 2);
+
+	if (blockCount >= 2)
+		return false;
+
+	if (blockCount == 1)
+	{
+		candidates[candidateCount++] = blocks[0];
+	}
+	else
+	{
+		//windows the new threat may come from, all of them at the root and otherwise ones through our earlier stones
+		solver.stamp++;
+		auto consider = [&](int window) noexcept
+		{
+			if (solver.windowStamps[window] == solver.stamp)
+				return;
+			solver.windowStamps[window] = solver.stamp;
+
+			int attackerStones = solver.counts[window * 3 + attacker];
+			if (solver.counts[window * 3 + defender] != 0)
+				return;
+			if (attackerStones != solver.winLength - 2 && !(solver.mode == ThreatFoursAndThrees && solver.threeDepth > 0 && attackerStones == solver.winLength - 3))
+				return;
+
+			const int16_t* cells = &solver.windowCells[window * solver.winLength];
+			for (int i = 0; i < solver.winLength; i++)
+			{
+				if (solver.board->cells[cells[i]] == PieceNone)
+					ThreatAddUnique(candidates, candidateCount, cells[i]);
+			}
+		};
+
+		if (solver.attackerMoveCount == 0)
+		{
+			for (int window = 0; window < solver.windowCount; window++)
+				consider(window);
+		}
+		else
+		{
+			for (int m = 0; m < solver.attackerMoveCount; m++)
+			{
+				int cell = solver.attackerMoves[m];
+				for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+					consider(solver.cellWindows[i]);
+			}
+		}
+
+		//moves making the most fours first
+		uint8_t fours[MaxBoardCells];
+		for (int i = 0; i < candidateCount; i++)
+			fours[i] = (uint8_t)ThreatFoursMadeBy(solver, candidates[i], attacker);
+
+		for (int i = 1; i < candidateCount; i++)
+		{
+			int16_t candidate = candidates[i];
+			uint8_t score = fours[i];
+			int j = i;
+			for (; j > 0 && fours[j - 1] < score; j--)
+			{
+				candidates[j] = candidates[j - 1];
+				fours[j] = fours[j - 1];
+			}
+			candidates[j] = candidate;
+			fours[j] = score;
+		}
+	}
+
+	for (int i = 0; i < candidateCount; i++)
+	{
+		int cell = candidates[i];
+
+		ThreatPlay(solver, cell);
+		solver.attackerMoves[solver.attackerMoveCount++] = (int16_t)cell;
+
+		bool won = BoardIsWinningMove(*solver.board, cell) || ThreatDefend(solver, depth, cell);
+
+		solver.attackerMoveCount--;
+		ThreatUndo(solver);
+
+		if (won)
+		{
+			bestMove = cell;
+			return true;
+		}
+
+		if (solver.aborted)
+			return false;
+	}
+
+	return false;
+}
+
+//looks for a forced win for the side to move, board is restored before returning
+[[nodiscard]]
+inline ThreatResult ThreatSolve(ThreatSolver& solver, Board& board, ThreatMode mode, uint64_t maxNodes, int maxDepth = 64, int maxThrees = 3) noexcept
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	solver.board = &board;
+	solver.mode = mode;
+	solver.attacker = board.toMove;
+	solver.threeDepth = maxThrees;
+	solver.nodes = 0;
+	solver.maxNodes = maxNodes;
+	solver.aborted = false;
+	solver.attackerMoveCount = 0;
+
+	for (uint8_t& count : solver.counts)
+		count = 0;
+	for (int cell = 0; cell < BoardCellCount(board); cell++)
+	{
+		if (board.cells[cell] == PieceNone)
+			continue;
+		for (int32_t i = solver.cellWindowStart[cell]; i < solver.cellWindowStart[cell + 1]; i++)
+			solver.counts[solver.cellWindows[i] * 3 + board.cells[cell]]++;
+	}
+
+	ThreatResult result =
+	{
+		.win = false,
+		.move = -1,
+		.length = 0,
+		.nodes = 0,
+		.elapsedNs = 0
+	};
+
+	if (!BoardLastMoveWon(board))
+	{
+		//iterative deepening so the shortest win is the one returned
+		solver.depthLimited = true;
+		for (int depth = 1; depth <= maxDepth && !result.win && !solver.aborted && solver.depthLimited; depth++)
+		{
+			solver.depthLimited = false;
+			result.win = ThreatAttack(solver, depth, -1, result.move);
+			result.length = depth;
+		}
+	}
+
+	if (!result.win)
+	{
+		result.move = -1;
+		result.length = 0;
+	}
+
+	result.nodes = solver.nodes;
+	result.elapsedNs = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+
+	return result;
+}
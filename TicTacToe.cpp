@@ -5,11 +5,23 @@
 */
 
 #include <Windows.h>
+#include <windowsx.h>
 #include <wrl.h>
 #include <d2d1.h>
 #include <dwrite.h>
 #include <sstream>
 
+#include "Board.h"
+#include "Search.h"
+#include "Ponder.h"
+#include "Renderer.h"
+#include "InputQueue.h"
+#include "Game.h"
+#include "StatsStore.h"
+#include "TTCache.h"
+#include "TimerWheel.h"
+#include "GameHost.h"
+
 #pragma comment(lib, "d2d1")
 #pragma comment(lib, "dwrite")
 
@@ -84,82 +96,215 @@ LRESULT CALLBACK IdleProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
 LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) noexcept;
 
 
-char boardState[9] = { 0 };
-
-int mouseInSquare = 9;
+//the game, its timer, the ponderer, the input queue and the scene, everything a frame needs but Direct2D
+GameHost host;
 
-bool mouseClicked = false;
+//the CPU's table from the last run, so its first replies come out of what it already searched
+constexpr const char* CPUTablePath = "TicTacToeCache.tt";
 
-int gameState = 0;
+InputLatencyStats inputLatency;
 
-int winType = 0;
+//every event is written here when the game is started with a trace path
+FILE* inputTrace = nullptr;
+int64_t inputTraceStartNs = 0;
 
-int playerScore = 0;
-int CPUScore = 0;
+//every game's result, kept next to the executable across restarts
+StatsStore statsStore;
+uint32_t statsPlayer = 0;
 
-int CPUMoveCount = 0;
-
-LARGE_INTEGER CPUThinkingTicks;
-LARGE_INTEGER GameFinishedTicks;
-LARGE_INTEGER CurrentTimerFinished;
+LARGE_INTEGER ProcessorFrequency;
 
 int windowWidth = 0;
 int windowHeight = 0;
 
+//what the render target's size and the text formats' height were made for, so a resize only redoes what it has to
+D2D1_SIZE_U renderTargetSize = {};
+int textFormatHeight = 0;
 
-[[nodiscard]]
-int CheckForWinner() noexcept
+
+//draws the scene with the window's Direct2D target, each cached layer is a compatible bitmap target of the same size
+class D2DRenderBackend final : public RenderBackend
 {
-	//horizontal
-	if (boardState[0] == boardState[1] && boardState[1] == boardState[2])
-		return 1;
+public:
+	void ReleaseLayers() noexcept
+	{
+		for (ComPtr<ID2D1BitmapRenderTarget>& layerTarget : layerTargets)
+			layerTarget.Reset();
+		target = renderTarget.Get();
+	}
 
-	if (boardState[3] == boardState[4] && boardState[4] == boardState[5])
-		return 2;
+	void BeginFrame() noexcept override
+	{
+		target = renderTarget.Get();
+		renderTarget->BeginDraw();
+	}
 
-	if (boardState[6] == boardState[7] && boardState[7] == boardState[8])
-		return 3;
+	void EndFrame() noexcept override
+	{
+		FATAL_ON_FAIL(renderTarget->EndDraw());
+	}
+
+	void Clear() noexcept override
+	{
+		target->Clear();
+	}
 
-	//vertical
-	if (boardState[0] == boardState[3] && boardState[3] == boardState[6])
-		return 4;
+	void FillRect(const RenderRect& rect, RenderColor color) noexcept override
+	{
+		target->FillRectangle(D2D1::RectF(rect.left, rect.top, rect.right, rect.bottom), Brush(color));
+	}
 
-	if (boardState[1] == boardState[4] && boardState[4] == boardState[7])
-		return 5;
+	void DrawSegment(RenderPoint from, RenderPoint to, RenderColor color, float width) noexcept override
+	{
+		target->DrawLine(D2D1::Point2F(from.x, from.y), D2D1::Point2F(to.x, to.y), Brush(color), width);
+	}
 
-	if (boardState[2] == boardState[5] && boardState[5] == boardState[8])
-		return 6;
+	void DrawCircle(RenderPoint centre, float radius, RenderColor color, float width) noexcept override
+	{
+		D2D1_ELLIPSE circle =
+		{
+			.point = D2D1::Point2F(centre.x, centre.y),
+			.radiusX = radius,
+			.radiusY = radius,
+		};
+		target->DrawEllipse(circle, Brush(color), width);
+	}
 
-	//diagonal
-	if (boardState[0] == boardState[4] && boardState[4] == boardState[8])
-		return 7;
+	void DrawLabel(const wchar_t* text, uint32_t length, RenderFont font, const RenderRect& area, RenderColor color) noexcept override
+	{
+		target->DrawTextW(text, length, Font(font), D2D1::RectF(area.left, area.top, area.right, area.bottom), Brush(color));
+	}
 
-	if (boardState[6] == boardState[4] && boardState[4] == boardState[2])
-		return 8;
+	void BeginLayer(RenderLayer layer) noexcept override
+	{
+		if (layerTargets[layer] == nullptr)
+			FATAL_ON_FAIL(renderTarget->CreateCompatibleRenderTarget(&layerTargets[layer]));
+
+		target = layerTargets[layer].Get();
+		layerTargets[layer]->BeginDraw();
+		layerTargets[layer]->Clear();
+		//cleartype needs an opaque background, which a layer doesn't have
+		layerTargets[layer]->SetTextAntialiasMode(D2D1_TEXT_ANTIALIAS_MODE_GRAYSCALE);
+		drawingLayer = layer;
+	}
 
-	return 0;
+	void EndLayer() noexcept override
+	{
+		FATAL_ON_FAIL(layerTargets[drawingLayer]->EndDraw());
+		target = renderTarget.Get();
+	}
+
+	void DrawLayer(RenderLayer layer) noexcept override
+	{
+		ComPtr<ID2D1Bitmap> bitmap;
+		FATAL_ON_FAIL(layerTargets[layer]->GetBitmap(&bitmap));
+		renderTarget->DrawBitmap(bitmap.Get());
+	}
+
+private:
+	[[nodiscard]]
+	static ID2D1SolidColorBrush* Brush(RenderColor color) noexcept
+	{
+		switch (color)
+		{
+		case ColorPlayer:
+			return PlayerBrush.Get();
+		case ColorCPU:
+			return CPUBrush.Get();
+		case ColorGhost:
+			return GhostBrush.Get();
+		default:
+			return brush.Get();
+		}
+	}
+
+	[[nodiscard]]
+	static IDWriteTextFormat* Font(RenderFont font) noexcept
+	{
+		switch (font)
+		{
+		case FontTitle:
+			return TitleTextFormat.Get();
+		case FontCopyright:
+			return CopyrightTextFormat.Get();
+		default:
+			return pTextFormat.Get();
+		}
+	}
+
+	ID2D1RenderTarget* target = nullptr;
+	ComPtr<ID2D1BitmapRenderTarget> layerTargets[LayerCount];
+	RenderLayer drawingLayer = LayerMenu;
+};
+
+D2DRenderBackend D2DBackend;
+
+[[nodiscard]]
+int64_t NowNs() noexcept
+{
+	LARGE_INTEGER tickCountNow;
+	FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
+
+	//split so the multiply can't overflow after a few hours of uptime
+	return tickCountNow.QuadPart / ProcessorFrequency.QuadPart * 1'000'000'000 +
+		tickCountNow.QuadPart % ProcessorFrequency.QuadPart * 1'000'000'000 / ProcessorFrequency.QuadPart;
 }
 
-void CreateAssets() noexcept
+void RecordResult(GameSession&, int winner, int winType, void*) noexcept
 {
-	RECT ClientRect;
-	FATAL_ON_FALSE(GetClientRect(Window, &ClientRect));
+	StatsRecordResult(statsStore, statsPlayer, winner == 2 ? StatsPlayerWin : winner == 1 ? StatsCPUWin : StatsTie, winType);
+}
 
-	D2D1_SIZE_U size = D2D1::SizeU(ClientRect.right, ClientRect.bottom);
+void SaveCPUTable() noexcept
+{
+	//nothing new to keep when the CPU never searched
+	if (host.CPUTable.probes != 0 && !TTCacheSave(host.CPUTable, CPUTablePath, 3, 3, 3))
+		OutputDebugStringA("unable to write the CPU's table\n");
+}
+
+void PushInput(InputKind kind, float x, float y, uint32_t key) noexcept
+{
+	InputEvent event =
+	{
+		.timeNs = NowNs(),
+		.x = x,
+		.y = y,
+		.key = key,
+		.kind = kind
+	};
 
-	FATAL_ON_FAIL(factory->CreateHwndRenderTarget(
-		D2D1::RenderTargetProperties(),
-		D2D1::HwndRenderTargetProperties(Window, size),
-		&renderTarget));
+	if (inputTrace != nullptr)
+	{
+		if (inputTraceStartNs == 0)
+			inputTraceStartNs = event.timeNs;
+		InputTraceWrite(inputTrace, event, inputTraceStartNs);
+	}
 
-	renderTarget->SetDpi(96, 96);
+	InputPush(host.input, event);
+}
 
+void RecordInputLatency(int handled) noexcept
+{
+	int64_t presentedNs = NowNs();
+	for (int i = 0; i < handled; i++)
+		InputLatencyRecord(inputLatency, presentedNs - host.eventTimes[i]);
+}
 
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 1.0f, 0.0f), &brush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 1.0f), &PlayerBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 0.0f, 0.0f), &CPUBrush));
-	FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(.564f, .564f, .564f), &GhostBrush));
+void ReportInputLatency() noexcept
+{
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "input to frame latency: %llu events, mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms, %llu dropped\n",
+		(unsigned long long)inputLatency.samples,
+		inputLatency.samples != 0 ? inputLatency.totalNs / 1e6 / inputLatency.samples : 0.0,
+		InputLatencyPercentile(inputLatency, .5) / 1e6,
+		InputLatencyPercentile(inputLatency, .99) / 1e6,
+		inputLatency.maxNs / 1e6,
+		(unsigned long long)host.input.dropped);
+	OutputDebugStringA(buffer);
+}
 
+void CreateTextFormats() noexcept
+{
 	FATAL_ON_FAIL(pDWriteFactory->CreateTextFormat(
 		L"Segoe UI",
 		NULL,
@@ -200,643 +345,102 @@ void CreateAssets() noexcept
 	FATAL_ON_FAIL(CopyrightTextFormat->SetTextAlignment(DWRITE_TEXT_ALIGNMENT_CENTER));
 }
 
-void DrawMenu() noexcept
+//the first call makes everything, after that the brushes are kept and the target is resized in place,
+//and the text formats and layers are only made again when the size they depend on has actually changed
+void CreateAssets() noexcept
 {
-	if (renderTarget == nullptr)
-	{
-		CreateAssets();
-	}
+	RECT ClientRect;
+	FATAL_ON_FALSE(GetClientRect(Window, &ClientRect));
 
-	renderTarget->BeginDraw();
-	renderTarget->Clear();
+	D2D1_SIZE_U size = D2D1::SizeU(ClientRect.right, ClientRect.bottom);
+	bool resized = true;
 
+	if (renderTarget == nullptr)
 	{
-		//title
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .1f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L" TIC          TOE", 17, TitleTextFormat.Get(), textArea, PlayerBrush.Get());
-		renderTarget->DrawTextW(L"TAC", 3, TitleTextFormat.Get(), textArea, CPUBrush.Get());
-	}
+		FATAL_ON_FAIL(factory->CreateHwndRenderTarget(
+			D2D1::RenderTargetProperties(),
+			D2D1::HwndRenderTargetProperties(Window, size),
+			&renderTarget));
 
-	POINT cursorPos;
-	FATAL_ON_FALSE(GetCursorPos(&cursorPos));
-	FATAL_ON_FALSE(ScreenToClient(Window, &cursorPos));
+		renderTarget->SetDpi(96, 96);
 
-	{
-		//play button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .3f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"PLAY", 4, pTextFormat.Get(), textArea, GhostBrush.Get());
-	}
 
-	{
-		//exit button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .45f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"EXIT", 4, pTextFormat.Get(), textArea, GhostBrush.Get());
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 1.0f, 0.0f), &brush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(0.0f, 0.0f, 1.0f), &PlayerBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(1.0f, 0.0f, 0.0f), &CPUBrush));
+		FATAL_ON_FAIL(renderTarget->CreateSolidColorBrush(D2D1::ColorF(.564f, .564f, .564f), &GhostBrush));
 	}
-
+	else if (size.width != renderTargetSize.width || size.height != renderTargetSize.height)
 	{
-		//copyright
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .9f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * 1.f
-		};
-		renderTarget->DrawTextW(L"\u24B8 2023 badasahog. All Rights Reserved", 37, CopyrightTextFormat.Get(), textArea, GhostBrush.Get());
+		FATAL_ON_FAIL(renderTarget->Resize(size));
 	}
-
-	if (cursorPos.x > windowWidth * .4f &&
-		cursorPos.x < windowWidth * .6f &&
-		cursorPos.y > windowHeight * .3f &&
-		cursorPos.y < windowHeight * .4f)
+	else
 	{
-		//play button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .3f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
+		//restored from the taskbar, or another WM_SIZE for the size it already is
+		resized = false;
+	}
 
-		renderTarget->DrawTextW(L"PLAY", 4, pTextFormat.Get(), textArea, brush.Get());
+	renderTargetSize = size;
 
-		if (mouseClicked)
-		{
-			gameState = 1;
-		}
-	}
-	else if (
-		cursorPos.x > windowWidth * .4f &&
-		cursorPos.x < windowWidth * .6f &&
-		cursorPos.y > windowHeight * .45f &&
-		cursorPos.y < windowHeight * .55f)
+	if (textFormatHeight != windowHeight)
 	{
-		//exit button
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = windowHeight * .45f,
-			.right = (FLOAT)windowWidth,
-			.bottom = windowHeight * .8f
-		};
-		renderTarget->DrawTextW(L"EXIT", 4, pTextFormat.Get(), textArea, brush.Get());
-
-		if (mouseClicked)
-		{
-			ExitProcess(EXIT_SUCCESS);
-		}
+		CreateTextFormats();
+		textFormatHeight = windowHeight;
+		resized = true;
 	}
 
-	mouseClicked = false;
+	if (!resized && host.layout.width == windowWidth && host.layout.height == windowHeight)
+		return;
 
-	FATAL_ON_FAIL(renderTarget->EndDraw());
+	//the old layers are the old size
+	D2DBackend.ReleaseLayers();
+	InvalidateLayers(host.layerCache);
+	ComputeLayout(host.layout, windowWidth, windowHeight);
 }
 
-void DrawGame() noexcept
+//the menu or the game, whichever the game is on once this frame's input is in
+void DrawFrame() noexcept
 {
-
 	if (renderTarget == nullptr)
 	{
 		CreateAssets();
 	}
 
-	renderTarget->BeginDraw();
-	renderTarget->Clear();
-
-	FLOAT ScoreWidth = .2 * windowWidth;
-
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = 0,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2 - ScoreWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-		renderTarget->DrawTextW(L"YOU", 3, pTextFormat.Get(), textArea, PlayerBrush.Get());
-	}
-
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2 - ScoreWidth,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-
-		std::wstring scoreText = std::to_wstring(playerScore);
-		renderTarget->DrawTextW(scoreText.c_str(), scoreText.length(), pTextFormat.Get(), textArea, PlayerBrush.Get());
-	}
-
-
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2 + ScoreWidth,
-			.top = 0,
-			.right = (FLOAT)windowWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-		renderTarget->DrawTextW(L"CPU", 3, pTextFormat.Get(), textArea, CPUBrush.Get());
-	}
-
-	{
-		D2D1_RECT_F textArea =
-		{
-			.left = (FLOAT)windowWidth / 2,
-			.top = 0,
-			.right = (FLOAT)windowWidth / 2 + ScoreWidth,
-			.bottom = (.1f / .5f) * windowHeight
-		};
-
-		std::wstring scoreText = std::to_wstring(CPUScore);
-		renderTarget->DrawTextW(scoreText.c_str(), scoreText.length(), pTextFormat.Get(), textArea, CPUBrush.Get());
-	}
-
-
-	D2D1_RECT_F boardArea =
-	{
-		.left = .205f / 2 * (FLOAT)windowWidth,
-		.top = (.1f / .8f) * windowHeight,
-		.right = (FLOAT)windowWidth - .205f / 2 * (FLOAT)windowWidth,
-		.bottom = (FLOAT)windowHeight - .08f * windowHeight
-	};
-
-	float boardWidth = boardArea.right - boardArea.left;
-
-	float lineWidth = (FLOAT)windowWidth * .02f;
-
-	float squareSize = (boardWidth - lineWidth * 2) / 3.f;
-
-	//draw the board
-
-	{
-		//first line
-		D2D1_RECT_F boardSquare =
-		{
-			.left = boardArea.left + squareSize,
-			.top = boardArea.top,
-			.right = boardArea.left + squareSize + lineWidth,
-			.bottom = boardArea.bottom
-		};
-		renderTarget->FillRectangle(boardSquare, brush.Get());
-	}
-
-	{
-		//second line
-		D2D1_RECT_F boardSquare =
-		{
-			.left = boardArea.left + squareSize * 2 + lineWidth,
-			.top = boardArea.top,
-			.right = boardArea.left + squareSize * 2 + lineWidth * 2,
-			.bottom = boardArea.bottom
-		};
-		renderTarget->FillRectangle(boardSquare, brush.Get());
-	}
-
-	{
-		//third line
-		D2D1_RECT_F boardSquare =
-		{
-			.left = boardArea.left,
-			.top = boardArea.top + squareSize,
-			.right = boardArea.right,
-			.bottom = boardArea.top + squareSize + lineWidth
-		};
-
-		renderTarget->FillRectangle(boardSquare, brush.Get());
-	}
-
-	{
-		//fourth line
-		D2D1_RECT_F boardSquare =
-		{
-			.left = boardArea.left,
-			.top = boardArea.top + squareSize * 2 + lineWidth,
-			.right = boardArea.right,
-			.bottom = boardArea.top + squareSize * 2 + lineWidth * 2
-		};
-
-		renderTarget->FillRectangle(boardSquare, brush.Get());
-	}
-
-	D2D1_POINT_2F squarePoints[9] =
-	{
-		{ boardArea.left + squareSize * 0 + lineWidth * 0, boardArea.top + squareSize * 0 + lineWidth * 0 },
-		{ boardArea.left + squareSize * 1 + lineWidth * 1, boardArea.top + squareSize * 0 + lineWidth * 0 },
-		{ boardArea.left + squareSize * 2 + lineWidth * 2, boardArea.top + squareSize * 0 + lineWidth * 0 },
-
-		{ boardArea.left + squareSize * 0 + lineWidth * 0, boardArea.top + squareSize * 1 + lineWidth * 1 },
-		{ boardArea.left + squareSize * 1 + lineWidth * 1, boardArea.top + squareSize * 1 + lineWidth * 1 },
-		{ boardArea.left + squareSize * 2 + lineWidth * 2, boardArea.top + squareSize * 1 + lineWidth * 1 },
-
-		{ boardArea.left + squareSize * 0 + lineWidth * 0, boardArea.top + squareSize * 2 + lineWidth * 2 },
-		{ boardArea.left + squareSize * 1 + lineWidth * 1, boardArea.top + squareSize * 2 + lineWidth * 2 },
-		{ boardArea.left + squareSize * 2 + lineWidth * 2, boardArea.top + squareSize * 2 + lineWidth * 2 }
-	};
-
-	//draw the pieces (or whatever they're called)
-
-	for (int i = 0; i < 9; i++)
-	{
-		switch (boardState[i])
-		{
-		case 1://O
-		{
-			D2D1_ELLIPSE circle =
-			{
-				.point =
-				{
-					.x = squarePoints[i].x + squareSize / 2,
-					.y = squarePoints[i].y + squareSize / 2,
-				},
-				.radiusX = squareSize * .3f,
-				.radiusY = squareSize * .3f,
-			};
-			renderTarget->DrawEllipse(circle, CPUBrush.Get(), squareSize * .15f);
-			break;
-		}
-		case 2://X
-		{
-			{
-				//first line
-				D2D1_POINT_2F firstPoint =
-				{
-					.x = squarePoints[i].x + squareSize * .08f,
-					.y = squarePoints[i].y + squareSize * .08f
-				};
-
-				D2D1_POINT_2F secondPoint =
-				{
-					.x = squarePoints[i].x + squareSize - squareSize * .08f,
-					.y = squarePoints[i].y + squareSize - squareSize * .08f
-				};
-
-				renderTarget->DrawLine(firstPoint, secondPoint, PlayerBrush.Get(), squareSize * .15f);
-			}
-
-			{
-				//second line
-				D2D1_POINT_2F firstPoint =
-				{
-					.x = squarePoints[i].x + squareSize - squareSize * .08f,
-					.y = squarePoints[i].y + squareSize * .08f
-				};
-
-				D2D1_POINT_2F secondPoint =
-				{
-					.x = squarePoints[i].x + squareSize * .08f,
-					.y = squarePoints[i].y + squareSize - squareSize * .08f
-				};
-
-				renderTarget->DrawLine(firstPoint, secondPoint, PlayerBrush.Get(), squareSize * .15f);
-			}
-
-			break;
-		}
-		}
-	}
-
-	if (gameState == 1)
-	{
-		POINT cursorPos;
-		FATAL_ON_FALSE(GetCursorPos(&cursorPos));
-		FATAL_ON_FALSE(ScreenToClient(Window, &cursorPos));
-
-		mouseInSquare = 9;
+	int handled = GameHostFrame(host, D2DBackend, NowNs());
 
-		if (cursorPos.x > boardArea.left &&
-			cursorPos.x < boardArea.right &&
-			cursorPos.y > boardArea.top &&
-			cursorPos.y < boardArea.bottom)
-		{
-			for (int i = 0; i < 9; i++)
-			{
-				if (cursorPos.x > squarePoints[i].x &&
-					cursorPos.x < squarePoints[i].x + squareSize &&
-					cursorPos.y > squarePoints[i].y &&
-					cursorPos.y < squarePoints[i].y + squareSize)
-				{
-					mouseInSquare = i;
-					break;
-				}
-			}
-		}
-
-		if (mouseInSquare != 9)
-		{
-			if (boardState[mouseInSquare] < 0)
-			{
-
-				{
-					//first line
-					D2D1_POINT_2F firstPoint =
-					{
-						.x = squarePoints[mouseInSquare].x + squareSize * .08f,
-						.y = squarePoints[mouseInSquare].y + squareSize * .08f
-					};
-
-					D2D1_POINT_2F secondPoint =
-					{
-						.x = squarePoints[mouseInSquare].x + squareSize - squareSize * .08f,
-						.y = squarePoints[mouseInSquare].y + squareSize - squareSize * .08f
-					};
-
-					renderTarget->DrawLine(firstPoint, secondPoint, GhostBrush.Get(), squareSize * .15f);
-				}
-
-				{
-					//second line
-					D2D1_POINT_2F firstPoint =
-					{
-						.x = squarePoints[mouseInSquare].x + squareSize - squareSize * .08f,
-						.y = squarePoints[mouseInSquare].y + squareSize * .08f
-					};
-
-					D2D1_POINT_2F secondPoint =
-					{
-						.x = squarePoints[mouseInSquare].x + squareSize * .08f,
-						.y = squarePoints[mouseInSquare].y + squareSize - squareSize * .08f
-					};
-
-					renderTarget->DrawLine(firstPoint, secondPoint, GhostBrush.Get(), squareSize * .15f);
-				}
-
-				if (mouseClicked)
-				{
-					boardState[mouseInSquare] = 2;
-
-					winType = CheckForWinner();
-
-					if (winType != 0)
-					{
-						playerScore++;
-						playerScore = min(playerScore, 999);
-						gameState = 3;
-						LARGE_INTEGER tickCountNow;
-						FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-						CurrentTimerFinished.QuadPart = tickCountNow.QuadPart + GameFinishedTicks.QuadPart;
-					}
-					else
-					{
-						gameState = 2;
-						LARGE_INTEGER tickCountNow;
-						FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-						CurrentTimerFinished.QuadPart = tickCountNow.QuadPart + CPUThinkingTicks.QuadPart;
-					}
-				}
-			}
-		}
-	}
-	else if (gameState == 2)
-	{
-		//CPU's turn
-		LARGE_INTEGER tickCountNow;
-		FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-		if (CPUMoveCount == 4)
-		{
-			//tie
-			gameState = 3;
-		}
-		else if (tickCountNow.QuadPart > CurrentTimerFinished.QuadPart)
-		{
-			int numOpenSpaces = 0;
-
-			int openSpaces[9] = { 0 };
-
-			for (int i = 0; i < 9; i++)
-			{
-				if (boardState[i] < 0)
-				{
-					openSpaces[numOpenSpaces] = i;
-					numOpenSpaces++;
-				}
-			}
-
-			boardState[openSpaces[rand() % numOpenSpaces]] = 1;
-
-			CPUMoveCount++;
-
-			winType = CheckForWinner();
-
-			if (winType != 0)
-			{
-				CPUScore++;
-				CPUScore = min(CPUScore, 999);
-				gameState = 3;
-				LARGE_INTEGER tickCountNow;
-				QueryPerformanceCounter(&tickCountNow);
-				CurrentTimerFinished.QuadPart = tickCountNow.QuadPart + GameFinishedTicks.QuadPart;
-			}
-			else
-			{
-				gameState = 1;
-			}
-		}
-	}
-	else if (gameState == 3)
+	if (host.game.exitRequested)
 	{
-		LARGE_INTEGER tickCountNow;
-		QueryPerformanceCounter(&tickCountNow);
-
-		FLOAT winLineMargin = boardWidth * .05f;
-		FLOAT winLineWidth = squareSize * .25f;
-
-		switch (winType)
-		{
-		case 1:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[0].x + winLineMargin,
-				.y = squarePoints[0].y + squareSize / 2
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[2].x + squareSize - winLineMargin,
-				.y = squarePoints[2].y + squareSize / 2
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 2:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[3].x + winLineMargin,
-				.y = squarePoints[3].y + squareSize / 2
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[5].x + squareSize - winLineMargin,
-				.y = squarePoints[5].y + squareSize / 2
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 3:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[6].x + winLineMargin,
-				.y = squarePoints[6].y + squareSize / 2
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[8].x + squareSize - winLineMargin,
-				.y = squarePoints[8].y + squareSize / 2
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 4:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[0].x + squareSize / 2,
-				.y = squarePoints[0].y + winLineMargin
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[6].x + squareSize / 2,
-				.y = squarePoints[6].y + squareSize - winLineMargin
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 5:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[1].x + squareSize / 2,
-				.y = squarePoints[1].y + winLineMargin
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[7].x + squareSize / 2,
-				.y = squarePoints[7].y + squareSize - winLineMargin
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 6:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[2].x + squareSize / 2,
-				.y = squarePoints[2].y + winLineMargin
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[8].x + squareSize / 2,
-				.y = squarePoints[8].y + squareSize - winLineMargin
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 7:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[0].x + winLineMargin,
-				.y = squarePoints[0].y + winLineMargin
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[8].x + squareSize - winLineMargin,
-				.y = squarePoints[8].y + squareSize - winLineMargin
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		case 8:
-		{
-			D2D1_POINT_2F firstPoint =
-			{
-				.x = squarePoints[2].x + squareSize - winLineMargin,
-				.y = squarePoints[2].y + winLineMargin
-			};
-
-			D2D1_POINT_2F secondPoint =
-			{
-				.x = squarePoints[6].x + winLineMargin,
-				.y = squarePoints[6].y + squareSize - winLineMargin
-			};
-
-			renderTarget->DrawLine(firstPoint, secondPoint, brush.Get(), winLineWidth);
-			break;
-		}
-		}
-
-		if (tickCountNow.QuadPart > CurrentTimerFinished.QuadPart)
-		{
-			boardState[0] = -1;
-			boardState[1] = -2;
-			boardState[2] = -3;
-			boardState[3] = -4;
-			boardState[4] = -5;
-			boardState[5] = -6;
-			boardState[6] = -7;
-			boardState[7] = -8;
-			boardState[8] = -9;
-			gameState = 1;
-			CPUMoveCount = 0;
-		}
+		//ExitProcess doesn't run destructors, so the last results have to be written out here
+		StatsClose(statsStore);
+		SaveCPUTable();
+		ExitProcess(EXIT_SUCCESS);
 	}
 
-	mouseClicked = false;
-
-	FATAL_ON_FAIL(renderTarget->EndDraw());
+	RecordInputLatency(handled);
 }
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, int nCmdShow)
 {
-	LARGE_INTEGER ProcessorFrequency;
 	FATAL_ON_FALSE(QueryPerformanceFrequency(&ProcessorFrequency));
 
-	CPUThinkingTicks.QuadPart = ProcessorFrequency.QuadPart * 1;
-	GameFinishedTicks.QuadPart = ProcessorFrequency.QuadPart * 3;
+	GameHostInit(host, (uint64_t)NowNs(), NowNs(), 1 << 12);
 
+	//the scores carry on from the last time this user played
+	if (StatsOpen(statsStore, "TicTacToeStats"))
 	{
-		LARGE_INTEGER tickCountNow;
-		FATAL_ON_FALSE(QueryPerformanceCounter(&tickCountNow));
-		srand(tickCountNow.LowPart);
+		const char* userName = getenv("USERNAME");
+		statsPlayer = StatsPlayer(statsStore, userName != nullptr ? userName : "player");
+
+		PlayerStats stats = StatsGet(statsStore, statsPlayer);
+		host.game.playerScore = (int64_t)stats.playerScore;
+		host.game.CPUScore = (int64_t)stats.CPUScore;
+		host.game.onResult = RecordResult;
 	}
 
+	//a path on the command line records every input event to it, for replaying with the replay tool
+	if (lpCmdLine != nullptr && lpCmdLine[0] != '\0')
+		inputTrace = fopen(lpCmdLine, "w");
+
 	SetThreadDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 
 	UINT dpi = GetDpiForSystem();
@@ -891,15 +495,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		&pDWriteFactory
 	));
 
-	boardState[0] = -1;
-	boardState[1] = -2;
-	boardState[2] = -3;
-	boardState[3] = -4;
-	boardState[4] = -5;
-	boardState[5] = -6;
-	boardState[6] = -7;
-	boardState[7] = -8;
-	boardState[8] = -9;
+	if (!TTCacheMap(host.CPUTable, CPUTablePath, 3, 3, 3, true))
+		TTResize(host.CPUTable, 1 << 12);
 
 	FATAL_ON_FALSE(ShowWindow(Window, SW_SHOW));
 
@@ -998,31 +595,24 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 	switch (uMsg)
 	{
 	case WM_DESTROY:
+		PonderShutdown(host.ponderer);
+		ReportInputLatency();
+		StatsClose(statsStore);
+		SaveCPUTable();
+		if (inputTrace != nullptr)
+			fclose(inputTrace);
 		PostQuitMessage(0);
 		return 0;
+	case WM_MOUSEMOVE:
+		PushInput(InputMove, (float)GET_X_LPARAM(lParam), (float)GET_Y_LPARAM(lParam), 0);
+		break;
 	case WM_LBUTTONUP:
 	case WM_LBUTTONDBLCLK:
-		mouseClicked = true;
+		PushInput(InputClick, (float)GET_X_LPARAM(lParam), (float)GET_Y_LPARAM(lParam), 0);
 		break;
 	case WM_KEYDOWN:
-		if (wParam == VK_ESCAPE) {
-			gameState = 0;
-
-			boardState[0] = -1;
-			boardState[1] = -2;
-			boardState[2] = -3;
-			boardState[3] = -4;
-			boardState[4] = -5;
-			boardState[5] = -6;
-			boardState[6] = -7;
-			boardState[7] = -8;
-			boardState[8] = -9;
-
-			playerScore = 0;
-			CPUScore = 0;
-			CPUMoveCount = 0;
-			mouseClicked = false;
-		}
+		if (wParam == VK_ESCAPE)
+			PushInput(InputKey, 0, 0, InputKeyEscape);
 		break;
 	case WM_DPICHANGED:
 		handleDpiChange();
@@ -1036,10 +626,7 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam)
 		CreateAssets();
 	[[fallthrough]];
 	case WM_PAINT:
-		if (gameState == 0)
-			DrawMenu();
-		else
-			DrawGame();
+		DrawFrame();
 		break;
 	default:
 		return DefWindowProcW(hwnd, uMsg, wParam, lParam);
@@ -0,0 +1,396 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//deadlines for any number of sessions, so a host wakes the ones whose time has come instead of checking every one every frame.
+//a hierarchical wheel: the bottom level has a slot per tick, and each level above a slot per block of 256 slots below it.
+//every level holds two rotations, the block the current tick is in and the next one, so the timers due in the next block
+//are moved down a level a few at a time while the current one runs out, instead of all at once when it starts.
+//inserting and cancelling are an append and a swap with the last entry, and a slot that comes due is handed over as a whole.
+//the lists are arrays of node indices rather than links through the nodes, so moving a slot down a level reads it in order
+//and doesn't wait on one cache miss before it can find the next node
+
+constexpr int TimerWheelSlotBits = 8;
+constexpr int TimerWheelLevels = 4;
+//two rotations of 256
+constexpr int TimerWheelSlots = 2 << TimerWheelSlotBits;
+
+//timers further out than the levels reach, looked at again each time the top level starts a new block
+constexpr uint32_t TimerWheelOverflowSlot = TimerWheelLevels * TimerWheelSlots;
+
+//timers inserted with a deadline in a tick the wheel has already handled, handed over by the next advance whatever its time
+constexpr uint32_t TimerWheelDueSlot = TimerWheelOverflowSlot + 1;
+
+constexpr uint32_t TimerNone = UINT32_MAX;
+
+//room every slot gets up front, so a wheel that never has more than this many timers in one slot never allocates after init
+constexpr size_t TimerWheelSlotReserve = 8;
+
+//generation << 32 | index, 0 is never a live timer
+using TimerHandle = uint64_t;
+
+struct TimerNode
+{
+	int64_t deadlineNs;
+	uint64_t payload;
+	//bumped each time the node is freed, so a handle to a timer that already fired or was cancelled does nothing
+	uint32_t generation;
+	//level * TimerWheelSlots + slot, TimerWheelOverflowSlot, TimerWheelDueSlot, or TimerNone while free
+	uint32_t slot;
+	//where it is in its slot's list, or the next free node while free
+	uint32_t position;
+};
+
+static_assert(sizeof(TimerNode) <= 32, "two timers to a cache line");
+
+struct TimerExpiry
+{
+	uint64_t payload;
+	int64_t deadlineNs;
+};
+
+struct TimerWheel
+{
+	//a tick is 1 << tickShift ns, deadlines are rounded up to one so nothing ever fires early
+	int tickShift = 20;
+	//every tick before this one has been handled
+	uint64_t currentTick = 0;
+
+	std::vector<TimerNode> nodes;
+	uint32_t freeList = TimerNone;
+	size_t active = 0;
+
+	//each keeps its capacity once emptied, so a wheel that has seen its busiest second stops allocating
+	std::vector<uint32_t> slots[TimerWheelDueSlot + 1];
+	//the list of the slot being cascaded, swapped in so the slot itself can take timers back meanwhile
+	std::vector<uint32_t> moving;
+	//one bit per slot with anything in it, so empty stretches are skipped without visiting them
+	uint64_t occupied[TimerWheelLevels][TimerWheelSlots / 64];
+};
+
+//expectedTimers sizes the pool up front so that many timers never reallocate
+inline void TimerWheelInit(TimerWheel& wheel, int64_t nowNs, int tickShift = 20, size_t expectedTimers = 1024)
+{
+	wheel.tickShift = tickShift;
+	wheel.currentTick = (uint64_t)nowNs >> tickShift;
+
+	wheel.nodes.clear();
+	wheel.nodes.reserve(expectedTimers);
+	wheel.freeList = TimerNone;
+	wheel.active = 0;
+
+	//moving swaps its list with the slot it cascades, so it needs the same room or a slot would end up with none
+	for (std::vector<uint32_t>& slot : wheel.slots)
+	{
+		slot.clear();
+		slot.reserve(TimerWheelSlotReserve);
+	}
+	wheel.moving.reserve(TimerWheelSlotReserve);
+
+	for (auto& level : wheel.occupied)
+		for (uint64_t& word : level)
+			word = 0;
+}
+
+[[nodiscard]]
+inline size_t TimerWheelActive(const TimerWheel& wheel) noexcept
+{
+	return wheel.active;
+}
+
+[[nodiscard]]
+constexpr uint64_t TimerWheelTickFor(int64_t deadlineNs, int tickShift) noexcept
+{
+	return deadlineNs <= 0 ? 0 : ((uint64_t)deadlineNs + (1ull << tickShift) - 1) >> tickShift;
+}
+
+//which list a timer due at tick belongs on: the lowest level whose two rotations reach it
+[[nodiscard]]
+inline uint32_t TimerWheelSlotFor(const TimerWheel& wheel, uint64_t tick) noexcept
+{
+	if (tick < wheel.currentTick)
+		tick = wheel.currentTick;
+
+	for (int level = 0; level < TimerWheelLevels; level++)
+	{
+		int shift = level * TimerWheelSlotBits;
+		if ((tick >> (shift + TimerWheelSlotBits)) - (wheel.currentTick >> (shift + TimerWheelSlotBits)) <= 1)
+			return (uint32_t)(level * TimerWheelSlots) + (uint32_t)((tick >> shift) & (TimerWheelSlots - 1));
+	}
+
+	return TimerWheelOverflowSlot;
+}
+
+inline void TimerWheelMarkSlot(TimerWheel& wheel, uint32_t slot, bool occupied) noexcept
+{
+	if (slot >= TimerWheelOverflowSlot)
+		return;
+
+	uint64_t& word = wheel.occupied[slot / TimerWheelSlots][(slot % TimerWheelSlots) / 64];
+	if (occupied)
+		word |= 1ull << (slot % 64);
+	else
+		word &= ~(1ull << (slot % 64));
+}
+
+inline void TimerWheelLink(TimerWheel& wheel, uint32_t index, uint32_t slot)
+{
+	std::vector<uint32_t>& list = wheel.slots[slot];
+	if (list.empty())
+		TimerWheelMarkSlot(wheel, slot, true);
+
+	TimerNode& node = wheel.nodes[index];
+	node.slot = slot;
+	node.position = (uint32_t)list.size();
+	list.push_back(index);
+}
+
+inline void TimerWheelUnlink(TimerWheel& wheel, uint32_t index) noexcept
+{
+	TimerNode& node = wheel.nodes[index];
+	std::vector<uint32_t>& list = wheel.slots[node.slot];
+
+	uint32_t last = list.back();
+	list[node.position] = last;
+	wheel.nodes[last].position = node.position;
+	list.pop_back();
+
+	if (list.empty())
+		TimerWheelMarkSlot(wheel, node.slot, false);
+}
+
+inline void TimerWheelFree(TimerWheel& wheel, uint32_t index) noexcept
+{
+	TimerNode& node = wheel.nodes[index];
+	node.generation++;
+	node.slot = TimerNone;
+	node.position = wheel.freeList;
+	wheel.freeList = index;
+	wheel.active--;
+}
+
+//a deadline already passed fires on the next advance
+[[nodiscard]]
+inline TimerHandle TimerWheelInsert(TimerWheel& wheel, int64_t deadlineNs, uint64_t payload)
+{
+	uint32_t index = wheel.freeList;
+	if (index != TimerNone)
+	{
+		wheel.freeList = wheel.nodes[index].position;
+	}
+	else
+	{
+		index = (uint32_t)wheel.nodes.size();
+		wheel.nodes.push_back(TimerNode{ .deadlineNs = 0, .payload = 0, .generation = 1, .slot = TimerNone, .position = TimerNone });
+	}
+
+	TimerNode& node = wheel.nodes[index];
+	node.deadlineNs = deadlineNs;
+	node.payload = payload;
+	wheel.active++;
+
+	uint64_t tick = TimerWheelTickFor(deadlineNs, wheel.tickShift);
+	TimerWheelLink(wheel, index, tick < wheel.currentTick ? TimerWheelDueSlot : TimerWheelSlotFor(wheel, tick));
+
+	return (uint64_t)node.generation << 32 | index;
+}
+
+//false when the timer has already fired or been cancelled
+inline bool TimerWheelCancel(TimerWheel& wheel, TimerHandle handle) noexcept
+{
+	uint32_t index = (uint32_t)handle;
+	if (handle == 0 || index >= wheel.nodes.size())
+		return false;
+
+	TimerNode& node = wheel.nodes[index];
+	if (node.generation != (uint32_t)(handle >> 32) || node.slot == TimerNone)
+		return false;
+
+	TimerWheelUnlink(wheel, index);
+	TimerWheelFree(wheel, index);
+	return true;
+}
+
+//moves every timer in the slot down to where it belongs now, the overflow slot can get some of its own back
+inline void TimerWheelCascade(TimerWheel& wheel, uint32_t slot)
+{
+	wheel.moving.swap(wheel.slots[slot]);
+	TimerWheelMarkSlot(wheel, slot, false);
+
+	for (uint32_t index : wheel.moving)
+		TimerWheelLink(wheel, index, TimerWheelSlotFor(wheel, TimerWheelTickFor(wheel.nodes[index].deadlineNs, wheel.tickShift)));
+
+	wheel.moving.clear();
+}
+
+//moves the last count timers of a slot for the next block down a level, where they belong already
+inline void TimerWheelDrain(TimerWheel& wheel, uint32_t slot, size_t count)
+{
+	std::vector<uint32_t>& list = wheel.slots[slot];
+
+	for (; count != 0 && !list.empty(); count--)
+	{
+		uint32_t index = list.back();
+		list.pop_back();
+		TimerWheelLink(wheel, index, TimerWheelSlotFor(wheel, TimerWheelTickFor(wheel.nodes[index].deadlineNs, wheel.tickShift)));
+	}
+
+	if (list.empty())
+		TimerWheelMarkSlot(wheel, slot, false);
+}
+
+//how far past from the first set bit in a level's ring is, looking at most length bits on, or -1
+[[nodiscard]]
+inline int TimerWheelRingFind(const uint64_t* bits, int from, int length) noexcept
+{
+	for (int offset = 0; offset < length;)
+	{
+		int position = (from + offset) & (TimerWheelSlots - 1);
+		int available = 64 - position % 64;
+		if (available > length - offset)
+			available = length - offset;
+
+		uint64_t word = bits[position / 64] >> (position % 64);
+		if (available < 64)
+			word &= (1ull << available) - 1;
+
+		if (word != 0)
+			return offset + std::countr_zero(word);
+
+		offset += available;
+	}
+	return -1;
+}
+
+//the first tick from the current one on that has a slot to fire, or starts a block whose slot above still has timers in it.
+//UINT64_MAX when there are no timers
+[[nodiscard]]
+inline uint64_t TimerWheelNextTick(const TimerWheel& wheel) noexcept
+{
+	uint64_t next = UINT64_MAX;
+
+	for (int level = 0; level < TimerWheelLevels; level++)
+	{
+		int shift = level * TimerWheelSlotBits;
+		uint64_t block = wheel.currentTick >> shift;
+
+		//what's left of the current rotation and all of the next
+		uint64_t first = block;
+		int length = TimerWheelSlots - (int)(block & ((1 << TimerWheelSlotBits) - 1));
+
+		//above the bottom level the current block's slot only counts while the current tick is the one that starts it
+		if (level != 0 && (wheel.currentTick & ((1ull << shift) - 1)) != 0)
+		{
+			first++;
+			length--;
+		}
+
+		int offset = TimerWheelRingFind(wheel.occupied[level], (int)(first & (TimerWheelSlots - 1)), length);
+		if (offset >= 0 && (first + (uint64_t)offset) << shift < next)
+			next = (first + (uint64_t)offset) << shift;
+	}
+
+	if (!wheel.slots[TimerWheelOverflowSlot].empty())
+	{
+		int shift = TimerWheelLevels * TimerWheelSlotBits;
+		uint64_t tick = (wheel.currentTick & ((1ull << shift) - 1)) == 0 ? wheel.currentTick : ((wheel.currentTick >> shift) + 1) << shift;
+		if (tick < next)
+			next = tick;
+	}
+
+	return next;
+}
+
+//hands every timer due by nowNs to expired, oldest slot first, and frees them. expired keeps its capacity between calls.
+//a timer is never handed over before its deadline, and at most a tick after it plus however long the caller took to advance
+inline void TimerWheelAdvance(TimerWheel& wheel, int64_t nowNs, std::vector<TimerExpiry>& expired)
+{
+	expired.clear();
+
+	if (nowNs < 0)
+		return;
+
+	uint64_t nowTick = (uint64_t)nowNs >> wheel.tickShift;
+	uint64_t startTick = wheel.currentTick;
+
+	std::vector<uint32_t>& due = wheel.slots[TimerWheelDueSlot];
+	for (uint32_t index : due)
+	{
+		const TimerNode& node = wheel.nodes[index];
+		expired.push_back(TimerExpiry{ .payload = node.payload, .deadlineNs = node.deadlineNs });
+		TimerWheelFree(wheel, index);
+	}
+	due.clear();
+
+	for (;;)
+	{
+		uint64_t tick = TimerWheelNextTick(wheel);
+		if (tick > nowTick)
+		{
+			//nothing is due in between, so jumping straight there can't pass over a slot
+			if (nowTick + 1 > wheel.currentTick)
+				wheel.currentTick = nowTick + 1;
+			break;
+		}
+
+		wheel.currentTick = tick;
+
+		//whatever wasn't drained from a block that starts now goes down in one go, the higher levels first
+		//so what they drop onto a lower level is cascaded again if it has to be
+		if ((tick & ((1ull << (TimerWheelLevels * TimerWheelSlotBits)) - 1)) == 0)
+			TimerWheelCascade(wheel, TimerWheelOverflowSlot);
+
+		for (int level = TimerWheelLevels - 1; level > 0; level--)
+		{
+			int shift = level * TimerWheelSlotBits;
+			if ((tick & ((1ull << shift) - 1)) == 0)
+				TimerWheelCascade(wheel, (uint32_t)(level * TimerWheelSlots) + (uint32_t)((tick >> shift) & (TimerWheelSlots - 1)));
+		}
+
+		uint32_t slot = (uint32_t)(tick & (TimerWheelSlots - 1));
+		std::vector<uint32_t>& list = wheel.slots[slot];
+
+		for (uint32_t index : list)
+		{
+			const TimerNode& node = wheel.nodes[index];
+			expired.push_back(TimerExpiry{ .payload = node.payload, .deadlineNs = node.deadlineNs });
+			TimerWheelFree(wheel, index);
+		}
+
+		list.clear();
+		TimerWheelMarkSlot(wheel, slot, false);
+
+		wheel.currentTick = tick + 1;
+	}
+
+	//each level's slot for the next block goes down in step with the ticks that passed, so it's empty by the time the
+	//last block below it starts and no one advance moves more than its share
+	uint64_t advanced = wheel.currentTick - startTick;
+	if (advanced == 0)
+		return;
+
+	for (int level = TimerWheelLevels - 1; level > 0; level--)
+	{
+		int shift = level * TimerWheelSlotBits;
+		uint64_t nextBlock = (wheel.currentTick >> shift) + 1;
+		uint32_t slot = (uint32_t)(level * TimerWheelSlots) + (uint32_t)(nextBlock & (TimerWheelSlots - 1));
+
+		size_t count = wheel.slots[slot].size();
+		if (count == 0)
+			continue;
+
+		uint64_t drainedBy = (nextBlock << shift) - (1ull << (shift - TimerWheelSlotBits));
+		uint64_t remaining = drainedBy > wheel.currentTick ? drainedBy - wheel.currentTick : 0;
+
+		TimerWheelDrain(wheel, slot, advanced >= remaining ? count : (size_t)((count * advanced + advanced + remaining - 1) / (advanced + remaining)));
+	}
+}
@@ -0,0 +1,1477 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//headless benchmarks for the parts of the game that don't need a window
+//build: g++ -std=c++20 -O2 -pthread Tools/Bench.cpp -o bench
+
+#include "../Board.h"
+#include "../Search.h"
+#include "../Ponder.h"
+#include "../ThreatSpace.h"
+#include "../Renderer.h"
+#include "../StatsStore.h"
+#include "../TTCache.h"
+#include "../SparseBoard.h"
+#include "../Qubic.h"
+#include "../Ultimate.h"
+#include "../Game.h"
+#include "../TimerWheel.h"
+#include "../Broadcast.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+[[nodiscard]]
+static int64_t NowNs() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+[[nodiscard]]
+static int ArgOr(int argc, char** argv, int index, int fallback) noexcept
+{
+	return index < argc ? atoi(argv[index]) : fallback;
+}
+
+static void PrintLatencies(const char* label, std::vector<int64_t>& latencies) noexcept
+{
+	if (latencies.empty())
+		return;
+
+	std::sort(latencies.begin(), latencies.end());
+
+	int64_t total = 0;
+	for (int64_t latency : latencies)
+		total += latency;
+
+	printf("%-12s replies %6zu  mean %10.1f us  p50 %10.1f us  p99 %10.1f us  max %10.1f us\n",
+		label,
+		latencies.size(),
+		total / 1000.0 / latencies.size(),
+		latencies[latencies.size() / 2] / 1000.0,
+		latencies[latencies.size() * 99 / 100] / 1000.0,
+		latencies.back() / 1000.0);
+}
+
+//plays the same random player moves twice, once replying cold and once replying from the ponder cache
+static int BenchPonder(int argc, char** argv)
+{
+	int width = ArgOr(argc, argv, 2, 4);
+	int height = ArgOr(argc, argv, 3, 4);
+	int winLength = ArgOr(argc, argv, 4, 4);
+	int depth = ArgOr(argc, argv, 5, 6);
+	int games = ArgOr(argc, argv, 6, 20);
+	int thinkMs = ArgOr(argc, argv, 7, 20);
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1)
+	{
+		fprintf(stderr, "bad board size\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("ponder: %dx%d k=%d depth %d, %d games, player thinks %d ms\n", width, height, winLength, depth, games, thinkMs);
+
+	SearchLimits limits = { .maxDepth = depth };
+
+	for (int pondering = 0; pondering < 2; pondering++)
+	{
+		std::vector<int64_t> latencies;
+		Ponderer ponderer;
+		TranspositionTable table;
+		TTResize(table, 1 << 16);
+		uint64_t rng = 12345;
+
+		for (int game = 0; game < games; game++)
+		{
+			Board board;
+			BoardInit(board, width, height, winLength);
+
+			while (!BoardLastMoveWon(board) && !BoardIsFull(board))
+			{
+				if (pondering)
+					PonderStart(ponderer, board, limits);
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(thinkMs));
+
+				int16_t moves[MaxBoardCells];
+				int moveCount = GenerateMoves(board, moves);
+				BoardPlay(board, moves[SplitMix64(rng) % moveCount]);
+
+				if (BoardLastMoveWon(board) || BoardIsFull(board))
+				{
+					PonderCancel(ponderer);
+					break;
+				}
+
+				int64_t clickTime = NowNs();
+
+				int reply;
+				if (!pondering || !PonderProbe(ponderer, board, reply))
+				{
+					PonderCancel(ponderer);
+					reply = SearchBestMove(board, limits, &table).bestMove;
+				}
+				PonderCancel(ponderer);
+
+				latencies.push_back(NowNs() - clickTime);
+				BoardPlay(board, reply);
+			}
+		}
+
+		PrintLatencies(pondering ? "pondering" : "cold", latencies);
+
+		if (pondering)
+		{
+			printf("%-12s hit rate %5.1f%%  (%llu hits, %llu misses)  saved %.1f ms total\n",
+				"",
+				PonderHitRate(ponderer.stats) * 100.0,
+				(unsigned long long)ponderer.stats.hits,
+				(unsigned long long)ponderer.stats.misses,
+				ponderer.stats.savedNs / 1e6);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//stones are written like "h8,i9" with the column as a letter from a and the row counted from 1
+[[nodiscard]]
+static bool PutStones(Board& board, const char* stones, int8_t piece) noexcept
+{
+	for (const char* at = stones; *at != '\0';)
+	{
+		int x = *at++ - 'a';
+		int y = 0;
+		while (*at >= '0' && *at <= '9')
+			y = y * 10 + (*at++ - '0');
+		y--;
+
+		if (x < 0 || x >= board.width || y < 0 || y >= board.height || board.cells[y * board.width + x] != PieceNone)
+			return false;
+
+		BoardPut(board, y * board.width + x, piece);
+
+		if (*at == ',')
+			at++;
+	}
+	return true;
+}
+
+struct ThreatPuzzle
+{
+	const char* name;
+	const char* xStones;
+	const char* oStones;
+	int8_t toMove;
+	ThreatMode mode;
+	bool win;
+};
+
+//15x15, five in a row. the first few are textbook shapes, the rest were pulled out of random self-play games
+static const ThreatPuzzle ThreatPuzzles[] =
+{
+	{ "open three", "h8,i8,j8", "h9,i9,g9", PieceX, ThreatFours, true },
+	{ "four-four", "e5,f5,g5,h6,h7,h8", "d5,h9,a1,a2,a3", PieceX, ThreatFours, true },
+	{ "no threats", "h8", "i9", PieceX, ThreatFoursAndThrees, false },
+	{ "blocked fours", "a1,b1,c1,d1,a3,b3,c3,d3", "e1,e3,o15,m15,k15,i13", PieceO, ThreatFoursAndThrees, false },
+	{ "vcf 8", "i6,i7,j7,f8,h8,j8,k8,f9,h9,i10", "g6,h6,f7,g7,h7,g9,g10,h10,h11,i11", PieceX, ThreatFours, true },
+	{ "vcf 4", "h5,g6,f7,g7,i7,h8,i8,f9,h10,h11", "h6,h7,j7,e8,f8,g8,j8,h9,g10,g11", PieceX, ThreatFours, true },
+	{ "vct 3", "f7,g7,h8,i8,j8,f9,h9", "g6,i7,f8,g8,g9,j9,i10", PieceX, ThreatFoursAndThrees, true },
+	{ "vct 4", "f6,g6,i7,j7,f8,g8,h8,j8,i9,f10,g10", "i6,j6,f7,g7,h7,i8,k8,f9,j9,k9,h10", PieceX, ThreatFoursAndThrees, true },
+	{ "vct 4 for O", "i6,j6,f7,h8,i8,j8,f9,h10", "g6,j7,g9,h9,i9,g10,i10", PieceO, ThreatFoursAndThrees, true },
+	{ "vct 5", "g6,h7,i7,j7,h8,k8,f9,h9,i9,j10", "h5,h6,i6,f7,g7,f8,i8,j8,g9,f10", PieceX, ThreatFoursAndThrees, true },
+};
+
+static int BenchThreats(int argc, char** argv)
+{
+	int repeat = ArgOr(argc, argv, 2, 100);
+	bool allMatched = true;
+
+	ThreatSolver solver;
+	ThreatSolverInit(solver, 15, 15, 5);
+
+	printf("threats: 15x15 k=5, best of %d runs\n", repeat);
+
+	for (const ThreatPuzzle& puzzle : ThreatPuzzles)
+	{
+		Board board;
+		BoardInit(board, 15, 15, 5);
+		if (!PutStones(board, puzzle.xStones, PieceX) || !PutStones(board, puzzle.oStones, PieceO))
+		{
+			fprintf(stderr, "bad puzzle %s\n", puzzle.name);
+			return EXIT_FAILURE;
+		}
+		BoardSetToMove(board, puzzle.toMove);
+
+		ThreatResult best = {};
+		for (int i = 0; i < repeat; i++)
+		{
+			ThreatResult result = ThreatSolve(solver, board, puzzle.mode, 1000000);
+			if (i == 0 || result.elapsedNs < best.elapsedNs)
+				best = result;
+		}
+
+		bool matched = best.win == puzzle.win;
+		allMatched &= matched;
+
+		char move[16] = "-";
+		if (best.win)
+			snprintf(move, sizeof(move), "%c%d", 'a' + best.move % 15, best.move / 15 + 1);
+
+		printf("  %-14s %-4s %-5s length %2d  move %-4s nodes %7llu  %9.1f us  %s\n",
+			puzzle.name,
+			puzzle.mode == ThreatFours ? "vcf" : "vct",
+			best.win ? "win" : "none",
+			best.length,
+			move,
+			(unsigned long long)best.nodes,
+			best.elapsedNs / 1000.0,
+			matched ? "ok" : "MISMATCH");
+	}
+
+	return allMatched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//stands in for Direct2D, counts what would have been drawn
+struct CountingBackend final : RenderBackend
+{
+	uint64_t frames = 0;
+	uint64_t clears = 0;
+	uint64_t rects = 0;
+	uint64_t segments = 0;
+	uint64_t circles = 0;
+	uint64_t labels = 0;
+	uint64_t layerDraws = 0;
+	uint64_t layerBuilds = 0;
+	//keeps the optimiser from dropping the geometry
+	float checksum = 0;
+
+	void BeginFrame() noexcept override { frames++; }
+	void EndFrame() noexcept override {}
+	void Clear() noexcept override { clears++; }
+
+	void FillRect(const RenderRect& rect, RenderColor) noexcept override
+	{
+		rects++;
+		checksum += rect.right - rect.left;
+	}
+
+	void DrawSegment(RenderPoint from, RenderPoint to, RenderColor, float width) noexcept override
+	{
+		segments++;
+		checksum += to.x - from.x + width;
+	}
+
+	void DrawCircle(RenderPoint centre, float radius, RenderColor, float) noexcept override
+	{
+		circles++;
+		checksum += centre.x + radius;
+	}
+
+	void DrawLabel(const wchar_t*, uint32_t length, RenderFont, const RenderRect& area, RenderColor) noexcept override
+	{
+		labels++;
+		checksum += area.top + length;
+	}
+
+	void BeginLayer(RenderLayer) noexcept override { layerBuilds++; }
+	void EndLayer() noexcept override {}
+	void DrawLayer(RenderLayer) noexcept override { layerDraws++; }
+
+	[[nodiscard]]
+	uint64_t DrawCalls() const noexcept
+	{
+		return clears + rects + segments + circles + labels + layerDraws;
+	}
+};
+
+//renders the same menu and game frames with and without the static layers cached, resizing the window every so often
+static int BenchFrames(int argc, char** argv)
+{
+	int frames = ArgOr(argc, argv, 2, 1000000);
+	int resizeEvery = ArgOr(argc, argv, 3, 1000);
+
+	if (frames < 1 || resizeEvery < 1)
+	{
+		fprintf(stderr, "bad frame count\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("frames: %d menu and %d game frames, resize every %d\n", frames, frames, resizeEvery);
+
+	//one finished game, replayed over and over: X centre, O corner, X corner, O blocks, X wins down the middle
+	static const int Moves[] = { 4, 0, 2, 6, 3, 5, 1, 7 };
+	static const char Pieces[] = { 2, 1, 2, 1, 2, 1, 2, 2 };
+
+	for (int cached = 0; cached < 2; cached++)
+	{
+		CountingBackend backend;
+		LayerCache cache;
+		cache.enabled = cached != 0;
+		SceneLayout layout;
+
+		int64_t menuNs = 0;
+		int64_t gameNs = 0;
+		uint64_t menuCalls = 0;
+
+		for (int scene = 0; scene < 2; scene++)
+		{
+			ComputeLayout(layout, 576, 576);
+			InvalidateLayers(cache);
+
+			char boardState[9] = { -1, -2, -3, -4, -5, -6, -7, -8, -9 };
+			int played = 0;
+
+			int64_t start = NowNs();
+			for (int frame = 0; frame < frames; frame++)
+			{
+				if (frame % resizeEvery == resizeEvery - 1)
+				{
+					int size = 480 + frame / resizeEvery % 4 * 96;
+					ComputeLayout(layout, size, size);
+					InvalidateLayers(cache);
+				}
+
+				if (scene == 0)
+				{
+					RenderMenu(backend, cache, layout, (MenuButton)(frame / 64 % 3));
+					continue;
+				}
+
+				//a move every 32 frames, the board clears once the line has been up a while
+				if (frame % 32 == 31)
+				{
+					if (played == 8)
+					{
+						for (int i = 0; i < 9; i++)
+							boardState[i] = (char)(-1 - i);
+						played = 0;
+					}
+					else
+					{
+						boardState[Moves[played]] = Pieces[played];
+						played++;
+					}
+				}
+
+				GameFrame gameFrame =
+				{
+					.boardState = boardState,
+					.ghostSquare = played < 8 && boardState[frame / 8 % 9] < 0 ? frame / 8 % 9 : 9,
+					.winType = played == 8 ? 5 : 0,
+					.playerScore = frame / 256,
+					.CPUScore = frame / 512
+				};
+
+				RenderGame(backend, cache, layout, gameFrame);
+			}
+			int64_t elapsed = NowNs() - start;
+
+			if (scene == 0)
+			{
+				menuNs = elapsed;
+				menuCalls = backend.DrawCalls();
+			}
+			else
+			{
+				gameNs = elapsed;
+			}
+		}
+
+		uint64_t gameCalls = backend.DrawCalls() - menuCalls;
+
+		printf("%-9s menu %5.2f draw calls/frame %7.1f ns/frame  game %5.2f draw calls/frame %7.1f ns/frame  labels/frame %5.2f  layer builds %llu  (checksum %.0f)\n",
+			cached ? "cached" : "uncached",
+			(double)menuCalls / frames,
+			(double)menuNs / frames,
+			(double)gameCalls / frames,
+			(double)gameNs / frames,
+			(double)backend.labels / (2.0 * frames),
+			(unsigned long long)backend.layerBuilds,
+			backend.checksum);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+[[nodiscard]]
+static bool SamePlayers(const std::vector<PlayerStats>& a, const std::vector<PlayerStats>& b) noexcept
+{
+	return a.size() == b.size() && memcmp(a.data(), b.data(), a.size() * sizeof(PlayerStats)) == 0;
+}
+
+static void RemoveStatsFiles(const char* path) noexcept
+{
+	char file[1100];
+	for (const char* suffix : { ".wal", ".snapshot", ".snapshot.tmp" })
+	{
+		snprintf(file, sizeof(file), "%s%s", path, suffix);
+		remove(file);
+	}
+}
+
+//appends results from several threads, first without waiting and then waiting on every one, and times reopening the store
+//from the log alone, from a snapshot, and with a torn record at the end of the log
+static int BenchStats(int argc, char** argv)
+{
+	int records = ArgOr(argc, argv, 2, 2000000);
+	int playerCount = ArgOr(argc, argv, 3, 10000);
+	int threadCount = ArgOr(argc, argv, 4, 4);
+	const char* path = argc > 5 ? argv[5] : "bench-stats";
+
+	if (records < 1 || playerCount < 1 || threadCount < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("stats: %d results for %d players from %d threads, files %s.*\n", records, playerCount, threadCount, path);
+
+	RemoveStatsFiles(path);
+
+	std::vector<PlayerStats> expected;
+	bool allMatched = true;
+
+	{
+		StatsStore store;
+		//only the explicit compaction below makes a snapshot
+		store.snapshotThreshold = UINT64_MAX;
+		if (!StatsOpen(store, path))
+		{
+			fprintf(stderr, "unable to open %s\n", path);
+			return EXIT_FAILURE;
+		}
+
+		std::vector<uint32_t> players(playerCount);
+		for (int i = 0; i < playerCount; i++)
+		{
+			char name[StatsNameLength];
+			snprintf(name, sizeof(name), "player%d", i);
+			players[i] = StatsPlayer(store, name);
+		}
+
+		static const StatsRecordKind Kinds[] = { StatsPlayerWin, StatsCPUWin, StatsTie };
+
+		for (int waitEach = 0; waitEach < 2; waitEach++)
+		{
+			//waiting on every update is bounded by how fast the disk syncs, so it gets far fewer of them
+			int count = waitEach ? records / 100 + threadCount : records;
+			StatsCounters before = store.counters;
+			std::atomic<int> failedWaits = 0;
+
+			int64_t start = NowNs();
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < threadCount; t++)
+			{
+				threads.emplace_back([&, t]() noexcept
+				{
+					uint64_t rng = 0x57A7500ull + (uint64_t)t;
+					uint64_t sequence = 0;
+					for (int i = t; i < count; i += threadCount)
+					{
+						uint64_t choice = SplitMix64(rng);
+						StatsRecordKind kind = Kinds[choice % 3];
+						sequence = StatsRecordResult(store, players[(choice >> 8) % (uint64_t)playerCount], kind, kind == StatsTie ? 0 : 1 + (int)(choice >> 40) % 8);
+						if (waitEach)
+							failedWaits += !StatsWaitDurable(store, sequence);
+					}
+					failedWaits += !StatsWaitDurable(store, sequence);
+				});
+			}
+
+			for (std::thread& thread : threads)
+				thread.join();
+
+			double seconds = (NowNs() - start) / 1e9;
+			uint64_t syncs = store.counters.syncs - before.syncs;
+			printf("  %-16s %9d updates in %7.3f s: %10.0f updates/sec, %7llu syncs, %8.1f updates/sync\n",
+				waitEach ? "durable each" : "group commit",
+				count,
+				seconds,
+				count / seconds,
+				(unsigned long long)syncs,
+				syncs != 0 ? (double)(store.counters.recordsWritten - before.recordsWritten) / syncs : 0.0);
+			if (failedWaits != 0)
+				printf("  %-16s %d waits saw a failed write, %llu batches retried\n", "", failedWaits.load(), (unsigned long long)store.counters.failedWrites);
+		}
+
+		expected = store.players;
+	}
+
+	//torn, when set, is the record count and discarded bytes a replay that stops at a torn record has to show
+	auto reopen = [&](const char* label, const StatsCounters* torn) noexcept
+	{
+		StatsStore store;
+		store.snapshotThreshold = UINT64_MAX;
+		bool opened = StatsOpen(store, path);
+		bool matched = opened && SamePlayers(store.players, expected) &&
+			(torn == nullptr || (store.counters.recoveredRecords == torn->recoveredRecords && store.counters.discardedBytes == torn->discardedBytes));
+		allMatched &= matched;
+
+		printf("  %-16s %9llu records replayed in %7.1f ms, %llu bytes discarded  %s\n",
+			label,
+			(unsigned long long)store.counters.recoveredRecords,
+			store.counters.recoveryNs / 1e6,
+			(unsigned long long)store.counters.discardedBytes,
+			matched ? "ok" : "MISMATCH");
+		return store.counters;
+	};
+
+	StatsCounters log = reopen("recover log", nullptr);
+
+	//half a record of garbage, as if the power went out mid write. the whole log has to replay up to it, and only it is cut off
+	{
+		char file[1100];
+		snprintf(file, sizeof(file), "%s.wal", path);
+		if (FILE* wal = fopen(file, "ab"))
+		{
+			char garbage[sizeof(StatsRecord) / 2];
+			memset(garbage, 0xCD, sizeof(garbage));
+			fwrite(garbage, sizeof(garbage), 1, wal);
+			fclose(wal);
+		}
+	}
+
+	StatsCounters torn = log;
+	torn.discardedBytes = sizeof(StatsRecord) / 2;
+	reopen("recover torn", &torn);
+
+	{
+		StatsStore store;
+		store.snapshotThreshold = UINT64_MAX;
+		if (StatsOpen(store, path))
+		{
+			int64_t start = NowNs();
+			StatsCompact(store);
+			//the compaction rides on the next batch, so give it one
+			uint64_t sequence = StatsRecordResult(store, 0, StatsTie, 0);
+			if (!StatsWaitDurable(store, sequence))
+				printf("  %-16s a write failed\n", "compact");
+			printf("  %-16s snapshot of %zu players in %.1f ms\n", "compact", store.players.size(), (NowNs() - start) / 1e6);
+			expected = store.players;
+		}
+	}
+
+	reopen("recover snapshot", nullptr);
+
+	RemoveStatsFiles(path);
+
+	return allMatched ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//plays a session of self-play games on a fresh table and saves it, then plays a second session with other seeds three ways:
+//on a fresh table, and on the saved one mapped back in with and without hashing every entry first.
+//the first move's time includes getting the table ready
+static int BenchCache(int argc, char** argv)
+{
+	int width = ArgOr(argc, argv, 2, 7);
+	int height = ArgOr(argc, argv, 3, 7);
+	int winLength = ArgOr(argc, argv, 4, 4);
+	int depth = ArgOr(argc, argv, 5, 7);
+	int games = ArgOr(argc, argv, 6, 4);
+	int tableMB = ArgOr(argc, argv, 7, 64);
+	const char* path = argc > 8 ? argv[8] : "bench-cache.tt";
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1 || depth < 1 || games < 1 || tableMB < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("cache: %dx%d k=%d depth %d, %d games, %d MB table, file %s\n", width, height, winLength, depth, games, tableMB, path);
+
+	remove(path);
+	bool ok = true;
+
+	static const char* const Modes[] = { "first session", "cold", "warm verified", "warm lazy" };
+
+	for (int mode = 0; mode < 4; mode++)
+	{
+		TranspositionTable table;
+		uint64_t rng = mode == 0 ? 0xCAC4Eull : 0x5EC0Dull;
+		uint64_t nodes = 0;
+		int64_t firstMoveNs = 0;
+		double firstHitRate = 0;
+
+		int64_t start = NowNs();
+
+		if (mode <= 1)
+		{
+			TTResize(table, ((size_t)tableMB << 20) / sizeof(TTEntry));
+		}
+		else if (!TTCacheMap(table, path, width, height, winLength, mode == 2))
+		{
+			fprintf(stderr, "unable to map %s\n", path);
+			ok = false;
+			break;
+		}
+
+		int64_t readyNs = NowNs() - start;
+
+		for (int game = 0; game < games; game++)
+		{
+			Board board;
+			BoardInit(board, width, height, winLength);
+
+			while (!BoardLastMoveWon(board) && !BoardIsFull(board))
+			{
+				SearchLimits limits = { .maxDepth = depth, .seed = (uint32_t)SplitMix64(rng) | 1 };
+				SearchResult result = SearchBestMove(board, limits, &table);
+				nodes += result.nodes;
+
+				if (firstMoveNs == 0)
+				{
+					firstMoveNs = NowNs() - start;
+					firstHitRate = table.probes != 0 ? (double)table.hits / table.probes : 0;
+				}
+
+				BoardPlay(board, result.bestMove);
+			}
+		}
+
+		int64_t totalNs = NowNs() - start;
+
+		printf("  %-14s ready %8.2f ms  first move %8.2f ms (hit rate %5.1f%%)  all games %8.1f ms  %10llu nodes  hit rate %5.1f%%\n",
+			Modes[mode],
+			readyNs / 1e6,
+			firstMoveNs / 1e6,
+			firstHitRate * 100.0,
+			totalNs / 1e6,
+			(unsigned long long)nodes,
+			table.probes != 0 ? (double)table.hits / table.probes * 100.0 : 0.0);
+
+		if (mode == 0)
+		{
+			int64_t saveStart = NowNs();
+			ok = TTCacheSave(table, path, width, height, winLength);
+			printf("  %-14s %zu entries in %.1f ms\n", "save", TTSize(table), (NowNs() - saveStart) / 1e6);
+			if (!ok)
+				break;
+		}
+	}
+
+	//a flipped bit has to be caught by the full check, and a different board by the header alone
+	if (ok)
+	{
+		TranspositionTable table;
+		bool wrongBoard = TTCacheMap(table, path, width + 1, height, winLength, false);
+
+		if (FILE* file = fopen(path, "r+b"))
+		{
+			fseek(file, (long)sizeof(TTCacheHeader) + 5, SEEK_SET);
+			int byte = fgetc(file);
+			fseek(file, (long)sizeof(TTCacheHeader) + 5, SEEK_SET);
+			fputc(byte ^ 1, file);
+			fclose(file);
+		}
+		bool damaged = TTCacheMap(table, path, width, height, winLength, true);
+
+		printf("  %-14s other board %s, damaged entry %s\n", "integrity", wrongBoard ? "ACCEPTED" : "rejected", damaged ? "ACCEPTED" : "rejected");
+		ok = !wrongBoard && !damaged;
+	}
+
+	remove(path);
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//grows one game on the unbounded board by random moves next to random stones, and at each tenfold stone count times
+//a move and its undo, the win check through a stone, and listing the candidate moves
+static int BenchSparse(int argc, char** argv)
+{
+	int stones = ArgOr(argc, argv, 2, 100000);
+	int winLength = ArgOr(argc, argv, 3, 5);
+	int radius = ArgOr(argc, argv, 4, 2);
+	int repeat = ArgOr(argc, argv, 5, 200000);
+
+	if (stones < 10 || winLength < 2 || radius < 1 || radius > SparseMaxRadius || repeat < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("sparse: up to %d stones, k=%d, candidates within %d\n", stones, winLength, radius);
+	printf("  %9s %8s %10s %14s %14s %16s %12s\n", "stones", "tiles", "candidates", "play+undo ns", "win check ns", "candidates us", "bytes/stone");
+
+	SparseBoard board;
+	SparseInit(board, winLength, radius, PieceX, (size_t)stones);
+
+	std::vector<SparseMove> candidates;
+	uint64_t rng = 0x5A125Eull;
+	uint64_t sink = 0;
+
+	for (int checkpoint = 10; checkpoint <= stones; checkpoint *= 10)
+	{
+		while (SparseMoveCount(board) < checkpoint)
+		{
+			if (board.moves.empty())
+			{
+				SparsePlay(board, 0, 0);
+				continue;
+			}
+
+			uint64_t choice = SplitMix64(rng);
+			SparseMove from = board.moves[(size_t)(choice % board.moves.size())];
+			int32_t x = from.x + (int32_t)((choice >> 32) % (uint64_t)(2 * radius + 1)) - radius;
+			int32_t y = from.y + (int32_t)((choice >> 48) % (uint64_t)(2 * radius + 1)) - radius;
+
+			//wins don't stop it, the point is how the board behaves once it's big
+			if (SparsePieceAt(board, x, y) == PieceNone)
+				SparsePlay(board, x, y);
+		}
+
+		SparseGenerateMoves(board, candidates);
+
+		int64_t start = NowNs();
+		for (int i = 0; i < repeat; i++)
+		{
+			SparseMove move = candidates[(size_t)(SplitMix64(rng) % candidates.size())];
+			SparsePlay(board, move.x, move.y);
+			sink += board.hash;
+			SparseUndo(board);
+		}
+		double playNs = (double)(NowNs() - start) / repeat;
+
+		start = NowNs();
+		for (int i = 0; i < repeat; i++)
+		{
+			SparseMove move = board.moves[(size_t)(SplitMix64(rng) % board.moves.size())];
+			sink += SparseIsWinningMove(board, move.x, move.y);
+		}
+		double winNs = (double)(NowNs() - start) / repeat;
+
+		int generations = repeat / checkpoint + 1;
+		start = NowNs();
+		for (int i = 0; i < generations; i++)
+		{
+			SparseGenerateMoves(board, candidates);
+			sink += candidates.size();
+		}
+		double generateUs = (double)(NowNs() - start) / generations / 1e3;
+
+		size_t bytes = board.tiles.capacity() * sizeof(SparseTile) + board.slots.capacity() * sizeof(uint32_t) + board.moves.capacity() * sizeof(SparseMove);
+
+		printf("  %9d %8zu %10zu %14.1f %14.1f %16.2f %12.1f\n",
+			checkpoint,
+			board.tiles.size(),
+			candidates.size(),
+			playNs,
+			winNs,
+			generateUs,
+			(double)bytes / checkpoint);
+	}
+
+	//keeps the timed loops from being optimized away
+	if (sink == 42)
+		printf("\n");
+
+	return EXIT_SUCCESS;
+}
+
+//cells as z * 16 + y * 4 + x. the side to move wins in each, found by playing out random openings and keeping the ones
+//where the quickest run of threats is at least 5 moves long
+static const char* const QubicPuzzles[] =
+{
+	"6 41 5 48 14 59",
+	"28 45 35 56 3 53 16 15",
+	"41 38 2 36 25 30 51 16",
+	"40 52 63 34 21 37 35 50",
+	"48 41 58 31 7 29 56 44 8 18 1",
+	"38 48 10 20 9 43 33 19 37 35 57",
+	"61 20 12 56 62 23 2 47 19 18 10 13 54",
+	"41 0 21 52 44 20 56 55 34 16 12 5 9",
+};
+
+//searches the empty board to a fixed depth with and without the symmetries, then proves the wins above once with the threat
+//sequence search and once with alpha-beta alone
+static int BenchQubic(int argc, char** argv)
+{
+	int depth = ArgOr(argc, argv, 2, 6);
+	int tableMB = ArgOr(argc, argv, 3, 64);
+	int maxSeconds = ArgOr(argc, argv, 4, 60);
+
+	if (depth < 1 || tableMB < 1 || maxSeconds < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("qubic: depth %d from the empty board, %d MB table\n", depth, tableMB);
+
+	TranspositionTable table;
+	TTResize(table, ((size_t)tableMB << 20) / sizeof(TTEntry));
+
+	for (int symmetry = 1; symmetry >= 0; symmetry--)
+	{
+		QubicBoard board;
+		QubicInit(board);
+		TTClear(table);
+
+		QubicLimits limits = { .maxDepth = depth, .symmetry = symmetry != 0 };
+		SearchResult result = QubicSearchBestMove(board, limits, &table);
+
+		printf("  %-15s %11llu nodes in %9.1f ms, %6.2f M nodes/sec, hit rate %5.1f%%, score %d\n",
+			symmetry ? "192 symmetries" : "no symmetries",
+			(unsigned long long)result.nodes,
+			result.elapsedNs / 1e6,
+			result.nodes / (result.elapsedNs / 1e3),
+			table.probes != 0 ? (double)table.hits / table.probes * 100.0 : 0.0,
+			result.score);
+	}
+
+	printf("  %-40s %12s %12s %24s\n", "position", "threats ms", "nodes", "alpha-beta only ms");
+
+	bool allSolved = true;
+
+	for (const char* puzzle : QubicPuzzles)
+	{
+		QubicBoard board;
+		QubicInit(board);
+
+		for (const char* cursor = puzzle; *cursor != '\0';)
+		{
+			char* end;
+			QubicPlay(board, (int)strtol(cursor, &end, 10));
+			cursor = end;
+		}
+
+		SearchResult results[2];
+		for (int mode = 0; mode < 2; mode++)
+		{
+			TTClear(table);
+			QubicLimits limits = { .maxTimeNs = maxSeconds * 1'000'000'000LL };
+			if (mode == 1)
+				limits.rootThreatDepth = 0;
+			results[mode] = QubicSearchBestMove(board, limits, &table);
+		}
+
+		bool solved = results[0].solved && results[0].score > DecisiveScore && results[1].solved && results[1].score > DecisiveScore;
+		allSolved &= solved;
+
+		printf("  %-40s %12.2f %12llu %13.1f (%llu nodes) %s\n",
+			puzzle,
+			results[0].elapsedNs / 1e6,
+			(unsigned long long)results[0].nodes,
+			results[1].elapsedNs / 1e6,
+			(unsigned long long)results[1].nodes,
+			solved ? "" : "NOT SOLVED");
+	}
+
+	return allSolved ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//random playouts from the empty board on one thread, then searches of the empty board with 1 to threads threads,
+//then the search against a random player as a check that the playouts are going somewhere
+static int BenchUltimate(int argc, char** argv)
+{
+	int moveMs = ArgOr(argc, argv, 2, 1000);
+	int maxThreads = ArgOr(argc, argv, 3, (int)std::thread::hardware_concurrency());
+	int games = ArgOr(argc, argv, 4, 20);
+	int gameMoveMs = ArgOr(argc, argv, 5, 20);
+
+	if (moveMs < 1 || maxThreads < 1 || games < 0 || gameMoveMs < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("ultimate: %d ms per search, up to %d threads\n", moveMs, maxThreads);
+
+	UltimateBoard empty;
+	UltimateInit(empty);
+
+	{
+		uint64_t random = 0x0171A7Eull;
+		uint64_t playouts = 0;
+		uint64_t moves = 0;
+		int results[4] = {};
+
+		int64_t start = NowNs();
+		int64_t endNs = start + moveMs * 1'000'000LL;
+		while ((playouts & 1023) != 0 || NowNs() < endNs)
+		{
+			UltimateBoard board = empty;
+			while (board.result == UltimateOngoing)
+				UltimatePlay(board, UltimateRandomMove(board, random));
+			results[board.result]++;
+			moves += (uint64_t)board.moveCount;
+			playouts++;
+		}
+		double seconds = (NowNs() - start) / 1e9;
+
+		printf("  playouts     %10.0f playouts/sec, %5.1f moves each, X wins %4.1f%% O wins %4.1f%% drawn %4.1f%%\n",
+			playouts / seconds,
+			(double)moves / playouts,
+			results[PieceX] * 100.0 / playouts,
+			results[PieceO] * 100.0 / playouts,
+			results[UltimateDraw] * 100.0 / playouts);
+	}
+
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		UltimateLimits limits = { .maxTimeNs = moveMs * 1'000'000LL, .threads = threads };
+		UltimateResult result = UltimateSearch(empty, limits);
+
+		printf("  %2d thread%s   %10.0f playouts/sec, %8.0f per thread, %9llu nodes, best move %d at %.1f%%\n",
+			threads,
+			threads == 1 ? " " : "s",
+			result.playouts / (result.elapsedNs / 1e9),
+			result.playouts / (result.elapsedNs / 1e9) / threads,
+			(unsigned long long)result.nodes,
+			result.bestMove,
+			result.winRate * 100.0);
+
+		if (threads * 2 > maxThreads && threads != maxThreads)
+			threads = maxThreads / 2;
+	}
+
+	if (games == 0)
+		return EXIT_SUCCESS;
+
+	int results[3] = {};
+	uint64_t random = 0xB0A4Dull;
+
+	for (int game = 0; game < games; game++)
+	{
+		UltimateBoard board;
+		UltimateInit(board);
+		//the search plays X in even games and O in odd ones
+		int8_t searcher = game % 2 == 0 ? PieceX : PieceO;
+
+		while (board.result == UltimateOngoing)
+		{
+			if (board.toMove == searcher)
+			{
+				UltimateLimits limits = { .maxTimeNs = gameMoveMs * 1'000'000LL, .threads = maxThreads, .seed = SplitMix64(random) };
+				UltimatePlay(board, UltimateSearch(board, limits).bestMove);
+			}
+			else
+			{
+				UltimatePlay(board, UltimateRandomMove(board, random));
+			}
+		}
+
+		results[board.result == searcher ? 0 : board.result == UltimateDraw ? 1 : 2]++;
+	}
+
+	printf("  vs random    %d games at %d ms a move: %d won, %d drawn, %d lost\n", games, gameMoveMs, results[0], results[1], results[2]);
+
+	return EXIT_SUCCESS;
+}
+
+struct TimerBenchSession
+{
+	GameSession game;
+	TimerHandle gameTimer;
+	TimerHandle playerTimer;
+	int64_t playerMoveNs;
+};
+
+//the first empty square after a random one, or -1 on a full board
+[[nodiscard]]
+static int RandomEmptySquare(const GameSession& session, uint64_t& random) noexcept
+{
+	int start = (int)(SplitMix64(random) % 9);
+	for (int i = 0; i < 9; i++)
+	{
+		int square = (start + i) % 9;
+		if (session.boardState[square] < 0)
+			return square;
+	}
+	return -1;
+}
+
+[[nodiscard]]
+static int RandomReply(GameSession& session, void*) noexcept
+{
+	return RandomEmptySquare(session, session.random);
+}
+
+//how long the simulated player looks at the board before clicking
+[[nodiscard]]
+static int64_t PlayerThinkNs(GameSession& session) noexcept
+{
+	return 200'000'000 + (int64_t)(SplitMix64(session.random) % 1'300'000'000);
+}
+
+static void PrintLateness(const char* label, std::vector<int64_t>& lateness) noexcept
+{
+	if (lateness.empty())
+		return;
+
+	std::sort(lateness.begin(), lateness.end());
+
+	printf("  %-14s jitter p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us  max %8.1f us  early %s\n",
+		label,
+		lateness[lateness.size() / 2] / 1000.0,
+		lateness[lateness.size() * 99 / 100] / 1000.0,
+		lateness[lateness.size() * 999 / 1000] / 1000.0,
+		lateness.back() / 1000.0,
+		lateness.front() < 0 ? "YES" : "none");
+}
+
+//millions of timers due over a few seconds of real time, then many sessions played through on a simulated clock,
+//once woken by the wheel and once by checking every session every step the way a frame loop does
+static int BenchTimers(int argc, char** argv)
+{
+	int timerCount = ArgOr(argc, argv, 2, 2000000);
+	int spreadMs = ArgOr(argc, argv, 3, 4000);
+	int sessionCount = ArgOr(argc, argv, 4, 50000);
+	int simulatedSeconds = ArgOr(argc, argv, 5, 20);
+
+	if (timerCount < 1 || spreadMs < 1 || sessionCount < 1 || simulatedSeconds < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("timers: %d timers over %d ms, %d sessions for %d simulated seconds\n", timerCount, spreadMs, sessionCount, simulatedSeconds);
+
+	{
+		TimerWheel wheel;
+		std::vector<TimerExpiry> expired;
+		std::vector<TimerHandle> handles(timerCount);
+		std::vector<int64_t> deadlines(timerCount);
+		uint64_t random = 0x7173E5ull;
+
+		int64_t start = NowNs();
+		TimerWheelInit(wheel, start, 20, (size_t)timerCount);
+
+		//deadlines start a little out so inserting them all doesn't eat into the first ones
+		int64_t firstDeadline = start + 500'000'000;
+		for (int i = 0; i < timerCount; i++)
+			deadlines[i] = firstDeadline + (int64_t)(SplitMix64(random) % ((uint64_t)spreadMs * 1'000'000));
+
+		int64_t insertStart = NowNs();
+		for (int i = 0; i < timerCount; i++)
+			handles[i] = TimerWheelInsert(wheel, deadlines[i], (uint64_t)i);
+		int64_t insertNs = NowNs() - insertStart;
+
+		//every tenth timer cancelled, and put back so the run below still has all of them
+		int64_t cancelStart = NowNs();
+		for (int i = 0; i < timerCount; i += 10)
+			TimerWheelCancel(wheel, handles[i]);
+		int64_t cancelNs = NowNs() - cancelStart;
+		int cancelled = (timerCount + 9) / 10;
+
+		for (int i = 0; i < timerCount; i += 10)
+			handles[i] = TimerWheelInsert(wheel, deadlines[i], (uint64_t)i);
+
+		//what checking every deadline once costs, which polling pays every frame
+		int64_t scanStart = NowNs();
+		int64_t now = NowNs();
+		int due = 0;
+		for (int64_t deadline : deadlines)
+			due += deadline <= now;
+		int64_t scanNs = NowNs() - scanStart;
+
+		printf("  insert %6.1f ns  cancel %6.1f ns  scanning all deadlines once %8.2f ms (%d due)\n",
+			(double)insertNs / timerCount,
+			(double)cancelNs / cancelled,
+			scanNs / 1e6,
+			due);
+
+		std::vector<int64_t> lateness;
+		lateness.reserve(timerCount);
+		uint64_t advances = 0;
+		int64_t advanceNs = 0;
+		int64_t busiestNs = 0;
+
+		while (TimerWheelActive(wheel) != 0)
+		{
+			int64_t nowNs = NowNs();
+			TimerWheelAdvance(wheel, nowNs, expired);
+			int64_t doneNs = NowNs();
+
+			advances++;
+			advanceNs += doneNs - nowNs;
+			if (doneNs - nowNs > busiestNs)
+				busiestNs = doneNs - nowNs;
+
+			for (const TimerExpiry& expiry : expired)
+				lateness.push_back(nowNs - expiry.deadlineNs);
+		}
+
+		printf("  %zu expired over %llu advances, %.0f ns per advance on average, busiest %.1f us\n",
+			lateness.size(),
+			(unsigned long long)advances,
+			(double)advanceNs / advances,
+			busiestNs / 1000.0);
+		PrintLateness("wheel", lateness);
+	}
+
+	for (int driven = 0; driven < 2; driven++)
+	{
+		std::vector<TimerBenchSession> sessions(sessionCount);
+		TimerWheel wheel;
+		std::vector<TimerExpiry> expired;
+		std::vector<int64_t> lateness;
+
+		//a simulated clock in 1 ms steps, started well away from 0 like a real one
+		const int64_t stepNs = 1'000'000;
+		int64_t nowNs = 1'000'000'000'000;
+		TimerWheelInit(wheel, nowNs, 20, (size_t)sessionCount * 2);
+
+		uint64_t games = 0;
+		auto countGame = [](GameSession&, int, int, void* context) noexcept { (*(uint64_t*)context)++; };
+
+		auto scheduleGame = [&](uint32_t index) noexcept
+		{
+			TimerBenchSession& session = sessions[index];
+			TimerWheelCancel(wheel, session.gameTimer);
+
+			int64_t deadline = GameNextDeadlineNs(session.game);
+			session.gameTimer = deadline == GameNoDeadlineNs ? 0 : TimerWheelInsert(wheel, deadline, (uint64_t)index * 2);
+
+			if (session.game.gameState == 1 && session.playerMoveNs == 0)
+			{
+				session.playerMoveNs = nowNs + PlayerThinkNs(session.game);
+				session.playerTimer = TimerWheelInsert(wheel, session.playerMoveNs, (uint64_t)index * 2 + 1);
+			}
+		};
+
+		for (uint32_t i = 0; i < (uint32_t)sessionCount; i++)
+		{
+			TimerBenchSession& session = sessions[i];
+			GameSessionInit(session.game, i + 1);
+			session.game.chooseReply = RandomReply;
+			session.game.onResult = countGame;
+			session.game.resultContext = &games;
+			session.game.gameState = 1;
+			session.gameTimer = 0;
+			session.playerTimer = 0;
+			session.playerMoveNs = 0;
+
+			if (driven)
+				scheduleGame(i);
+		}
+
+		uint64_t wakeups = 0;
+		int64_t endNs = nowNs + simulatedSeconds * 1'000'000'000LL;
+		int64_t start = NowNs();
+
+		for (; nowNs < endNs; nowNs += stepNs)
+		{
+			if (driven)
+			{
+				TimerWheelAdvance(wheel, nowNs, expired);
+				wakeups += expired.size();
+
+				for (const TimerExpiry& expiry : expired)
+				{
+					uint32_t index = (uint32_t)(expiry.payload / 2);
+					GameSession& game = sessions[index].game;
+
+					if (expiry.payload % 2 == 1)
+					{
+						sessions[index].playerMoveNs = 0;
+						if (game.gameState == 1)
+							GamePlayerMove(game, RandomEmptySquare(game, game.random), nowNs);
+					}
+					else
+					{
+						if (expiry.deadlineNs != 0)
+							lateness.push_back(nowNs - expiry.deadlineNs);
+						GameAdvance(game, nowNs);
+					}
+
+					scheduleGame(index);
+				}
+			}
+			else
+			{
+				for (TimerBenchSession& session : sessions)
+				{
+					GameSession& game = session.game;
+					int state = game.gameState;
+					int64_t deadline = GameNextDeadlineNs(game);
+					GameAdvance(game, nowNs);
+					wakeups++;
+
+					if (game.gameState != state && deadline != 0)
+						lateness.push_back(nowNs - deadline);
+
+					if (game.gameState == 1 && session.playerMoveNs == 0)
+						session.playerMoveNs = nowNs + PlayerThinkNs(game);
+
+					if (game.gameState == 1 && nowNs >= session.playerMoveNs)
+					{
+						session.playerMoveNs = 0;
+						GamePlayerMove(game, RandomEmptySquare(game, game.random), nowNs);
+					}
+				}
+			}
+		}
+
+		double seconds = (NowNs() - start) / 1e9;
+
+		printf("  %-14s %8llu games  %10.0f session wakeups/simulated sec  %8.2f ms per simulated sec  %6.1fx real time\n",
+			driven ? "wheel driven" : "polled",
+			(unsigned long long)games,
+			wakeups / (double)simulatedSeconds,
+			seconds * 1000.0 / simulatedSeconds,
+			simulatedSeconds / seconds);
+		PrintLateness(driven ? "wheel driven" : "polled", lateness);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//the spectator's end of the connection, kept apart from BroadcastSubscriber since it isn't the server's memory
+struct SpectatorView
+{
+	BroadcastState state;
+	uint32_t sequence;
+};
+
+static int BenchBroadcast(int argc, char** argv)
+{
+	int subscriberCount = ArgOr(argc, argv, 2, 100000);
+	int gameCount = ArgOr(argc, argv, 3, 1000);
+	int simulatedSeconds = ArgOr(argc, argv, 4, 60);
+	int slowPercent = ArgOr(argc, argv, 5, 5);
+
+	if (subscriberCount < 1 || gameCount < 1 || simulatedSeconds < 1 || slowPercent < 0 || slowPercent > 100)
+	{
+		fprintf(stderr, "bench broadcast: invalid arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	//games move on in 10 ms steps, fast spectators take everything as soon as it's published,
+	//slow ones get round to their connection every 10 simulated seconds and take one message when they do
+	const int64_t stepNs = 10'000'000;
+	const int slowEvery = 1000;
+	int64_t steps = simulatedSeconds * 1'000'000'000LL / stepNs;
+
+	//spectators grouped by the game they watch, and the slow ones by the step they wake up on
+	std::vector<uint32_t> watchingStart(gameCount + 1, 0);
+	std::vector<uint32_t> watching(subscriberCount);
+	std::vector<std::vector<uint32_t>> slowByStep(slowEvery);
+	for (int i = 0; i < subscriberCount; i++)
+		watchingStart[i % gameCount + 1]++;
+	for (int game = 0; game < gameCount; game++)
+		watchingStart[game + 1] += watchingStart[game];
+	{
+		std::vector<uint32_t> filled(watchingStart.begin(), watchingStart.end() - 1);
+		for (int i = 0; i < subscriberCount; i++)
+		{
+			watching[filled[i % gameCount]++] = (uint32_t)i;
+			if (i % 100 < slowPercent)
+				slowByStep[(i / 100) % slowEvery].push_back((uint32_t)i);
+		}
+	}
+
+	printf("broadcast: %d spectators of %d games for %d simulated seconds, %d%% slow\n", subscriberCount, gameCount, simulatedSeconds, slowPercent);
+
+	for (int shared = 1; shared >= 0; shared--)
+	{
+		BroadcastHub hub;
+		BroadcastInit(hub, gameCount);
+
+		std::vector<GameSession> games(gameCount);
+		std::vector<int64_t> playerMoveNs(gameCount, 0);
+		std::vector<BroadcastSubscriber> subscribers(subscriberCount);
+		std::vector<SpectatorView> views(subscriberCount);
+		//only for comparison, every spectator with its own copy of everything it hasn't been sent yet
+		std::vector<std::vector<uint8_t>> outboxes(shared ? 0 : subscriberCount);
+
+		for (int game = 0; game < gameCount; game++)
+		{
+			GameSessionInit(games[game], game + 1);
+			games[game].chooseReply = RandomReply;
+			games[game].gameState = 1;
+			(void)BroadcastAddChannel(hub);
+		}
+
+		for (int i = 0; i < subscriberCount; i++)
+		{
+			subscribers[i] = BroadcastSubscriber{ .channel = (uint32_t)(i % gameCount), .nextSequence = 0 };
+			views[i] = SpectatorView{ .state = {}, .sequence = 0 };
+		}
+
+		uint64_t published = 0;
+		uint64_t delivered = 0;
+		uint64_t bytes = 0;
+		uint64_t catchUps = 0;
+		uint64_t errors = 0;
+		size_t peakBacklog = 0;
+		int64_t fanOutNs = 0;
+
+		//takes a message off the top of the spectator's queue, false once it has nothing left to send
+		auto send = [&](uint32_t index) noexcept
+		{
+			SpectatorView& view = views[index];
+			uint32_t before = view.sequence;
+			uint32_t length;
+
+			if (shared)
+			{
+				const BroadcastBuffer* buffer = BroadcastPoll(hub, subscribers[index]);
+				if (buffer == nullptr)
+					return false;
+
+				length = buffer->length;
+				errors += !BroadcastApply(view.state, view.sequence, buffer->bytes, length);
+				BroadcastRelease(hub, buffer);
+			}
+			else
+			{
+				std::vector<uint8_t>& outbox = outboxes[index];
+				if (outbox.empty())
+					return false;
+
+				length = outbox[0] == BroadcastDelta ? BroadcastDeltaBytes : BroadcastSnapshotBytes;
+				errors += !BroadcastApply(view.state, view.sequence, outbox.data(), length);
+				outbox.erase(outbox.begin(), outbox.begin() + length);
+			}
+
+			delivered++;
+			bytes += length;
+			catchUps += view.sequence - before > 1;
+			return true;
+		};
+
+		auto isSlow = [&](uint32_t index) noexcept { return (int)(index % 100) < slowPercent; };
+
+		int64_t nowNs = 1'000'000'000'000;
+		for (int64_t step = 0; step < steps; step++, nowNs += stepNs)
+		{
+			for (int game = 0; game < gameCount; game++)
+			{
+				GameSession& session = games[game];
+				GameAdvance(session, nowNs);
+
+				if (session.gameState == 1 && playerMoveNs[game] == 0)
+					playerMoveNs[game] = nowNs + PlayerThinkNs(session);
+
+				if (session.gameState == 1 && nowNs >= playerMoveNs[game])
+				{
+					playerMoveNs[game] = 0;
+					GamePlayerMove(session, RandomEmptySquare(session, session.random), nowNs);
+				}
+
+				if (BroadcastCapture(hub, (uint32_t)game, session) == 0)
+					continue;
+
+				published++;
+				int64_t start = NowNs();
+
+				const BroadcastChannel& channel = hub.channels[game];
+				const BroadcastBuffer* message = channel.history[channel.sequence % BroadcastHistory];
+
+				for (uint32_t i = watchingStart[game]; i < watchingStart[game + 1]; i++)
+				{
+					uint32_t index = watching[i];
+					if (!shared)
+					{
+						std::vector<uint8_t>& outbox = outboxes[index];
+						outbox.insert(outbox.end(), message->bytes, message->bytes + message->length);
+						peakBacklog = std::max(peakBacklog, outbox.size());
+					}
+
+					if (!isSlow(index))
+						while (send(index)) {}
+				}
+
+				fanOutNs += NowNs() - start;
+			}
+
+			int64_t start = NowNs();
+			for (uint32_t index : slowByStep[step % slowEvery])
+			{
+				//one message on a slow link, but everything queued up if it was copied, since a backlog has to be worked through
+				if (shared)
+					send(index);
+				else
+					while (send(index)) {}
+			}
+			fanOutNs += NowNs() - start;
+		}
+
+		//the memory is counted while the slow spectators are still behind, then everyone catches up to check what they saw
+		size_t memory = BroadcastMemoryBytes(hub) + subscribers.size() * sizeof(BroadcastSubscriber);
+		for (const std::vector<uint8_t>& outbox : outboxes)
+			memory += sizeof(outbox) + outbox.capacity();
+
+		uint64_t mismatched = 0;
+		for (int i = 0; i < subscriberCount; i++)
+		{
+			while (send((uint32_t)i)) {}
+			const BroadcastState& truth = hub.channels[subscribers[i].channel].state;
+			mismatched += memcmp(&views[i].state, &truth, sizeof(truth)) != 0;
+		}
+
+		printf("  %-7s %9llu published  %11llu delivered  %10.0f messages/sec  %5.2f bytes/message  %7.1f bytes/spectator  %8llu snapshot catch ups",
+			shared ? "shared" : "copied",
+			(unsigned long long)published,
+			(unsigned long long)delivered,
+			delivered / (fanOutNs / 1e9),
+			(double)bytes / delivered,
+			(double)memory / subscriberCount,
+			(unsigned long long)catchUps);
+		if (!shared)
+			printf("  longest backlog %zu bytes", peakBacklog);
+		printf("\n");
+
+		if (errors != 0 || mismatched != 0)
+		{
+			printf("FAILED: %llu messages didn't apply, %llu spectators ended up seeing the wrong board\n", (unsigned long long)errors, (unsigned long long)mismatched);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+struct Benchmark
+{
+	const char* name;
+	const char* usage;
+	int(*run)(int argc, char** argv);
+};
+
+static const Benchmark Benchmarks[] =
+{
+	{ "ponder", "[width height k depth games thinkMs]", BenchPonder },
+	{ "threats", "[repeat]", BenchThreats },
+	{ "frames", "[frames resizeEvery]", BenchFrames },
+	{ "stats", "[records players threads path]", BenchStats },
+	{ "cache", "[width height k depth games tableMB path]", BenchCache },
+	{ "sparse", "[stones k radius repeat]", BenchSparse },
+	{ "qubic", "[depth tableMB maxSeconds]", BenchQubic },
+	{ "ultimate", "[moveMs threads games gameMoveMs]", BenchUltimate },
+	{ "timers", "[timers spreadMs sessions simulatedSeconds]", BenchTimers },
+	{ "broadcast", "[subscribers games simulatedSeconds slowPercent]", BenchBroadcast },
+};
+
+int main(int argc, char** argv)
+{
+	if (argc >= 2)
+	{
+		for (const Benchmark& benchmark : Benchmarks)
+		{
+			if (strcmp(argv[1], benchmark.name) == 0)
+				return benchmark.run(argc, argv);
+		}
+	}
+
+	fprintf(stderr, "usage:\n");
+	for (const Benchmark& benchmark : Benchmarks)
+		fprintf(stderr, "  %s %s %s\n", argv[0], benchmark.name, benchmark.usage);
+
+	return EXIT_FAILURE;
+}
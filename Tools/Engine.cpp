@@ -0,0 +1,425 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//the CPU player behind a UCI-like line protocol on stdin/stdout, for tournament runners and regression scripts.
+//everything that was piped in at once is handled before anything is written back, and nothing is allocated per command
+//build: g++ -std=c++20 -O2 Tools/Engine.cpp -o engine
+//
+//  uci                                  -> id lines, uciok
+//  isready                              -> readyok
+//  setoption name Hash value <MB>
+//  setoption name Threats value <nodes>
+//  setoption name CacheFile value <prefix>
+//                                       keeps the transposition table in <prefix>-<width>x<height>x<k>.tt between runs,
+//                                       mapped back in when the board size is set and saved on newgame and quit
+//  newgame                              clears the transposition table, or saves it when there's a cache file
+//  position <width> <height> <k> [moves <move>...]
+//                                       moves are a column letter and a row number from 1, e.g. b2, X moves first
+//  go [depth <n>] [nodes <n>] [movetime <ms>] [seed <n>]
+//                                       -> info depth <d> score cp <s>|mate <n> nodes <n> nps <n> time <ms> pv <move>
+//                                       -> bestmove <move>|none
+//  d                                    -> the board, one row per line
+//  quit
+
+#include "../Board.h"
+#include "../Search.h"
+#include "../TTCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+constexpr size_t InputBufferSize = 1 << 16;
+constexpr size_t OutputBufferSize = 1 << 16;
+constexpr int MaxTokens = MaxBoardCells + 16;
+
+struct Engine
+{
+	Board board;
+	TranspositionTable table;
+	uint64_t threatNodes = 4096;
+
+	//the board size the table's entries were searched on, and where they're kept between runs
+	int tableWidth = 3;
+	int tableHeight = 3;
+	int tableWinLength = 3;
+	char cachePrefix[1024] = {};
+
+	char input[InputBufferSize];
+	size_t inputLength = 0;
+
+	char output[OutputBufferSize];
+	size_t outputLength = 0;
+
+	//the current line split in place
+	const char* tokens[MaxTokens];
+	int tokenCount = 0;
+
+	bool quit = false;
+};
+
+static void Flush(Engine& engine) noexcept
+{
+	size_t written = 0;
+	while (written < engine.outputLength)
+	{
+#ifdef _WIN32
+		int result = _write(1, engine.output + written, (unsigned)(engine.outputLength - written));
+#else
+		ssize_t result = write(1, engine.output + written, engine.outputLength - written);
+#endif
+		if (result <= 0)
+		{
+			engine.quit = true;
+			break;
+		}
+		written += (size_t)result;
+	}
+	engine.outputLength = 0;
+}
+
+//appends one formatted line, flushing first if it might not fit
+template<typename... Arguments>
+static void Reply(Engine& engine, const char* format, Arguments... arguments) noexcept
+{
+	if (OutputBufferSize - engine.outputLength < 1024)
+		Flush(engine);
+
+	int length = snprintf(engine.output + engine.outputLength, OutputBufferSize - engine.outputLength, format, arguments...);
+	if (length > 0)
+		engine.outputLength += (size_t)length < OutputBufferSize - engine.outputLength ? (size_t)length : OutputBufferSize - engine.outputLength - 1;
+}
+
+[[nodiscard]]
+static bool TokenIs(const Engine& engine, int index, const char* word) noexcept
+{
+	return index < engine.tokenCount && strcmp(engine.tokens[index], word) == 0;
+}
+
+//"b2" to a cell index, -1 when it isn't on the board
+[[nodiscard]]
+static int ParseMove(const Board& board, const char* text) noexcept
+{
+	if (text[0] < 'a' || text[0] > 'z')
+		return -1;
+
+	int column = text[0] - 'a';
+	char* end;
+	long row = strtol(text + 1, &end, 10) - 1;
+
+	if (*end != '\0' || column >= board.width || row < 0 || row >= board.height)
+		return -1;
+
+	return (int)row * board.width + column;
+}
+
+static void FormatMove(const Board& board, int cell, char (&text)[16]) noexcept
+{
+	if (cell < 0)
+	{
+		strcpy(text, "none");
+		return;
+	}
+
+	snprintf(text, sizeof(text), "%c%d", 'a' + cell % board.width, cell / board.width + 1);
+}
+
+static void CachePath(const Engine& engine, char (&path)[1100]) noexcept
+{
+	snprintf(path, sizeof(path), "%s-%dx%dx%d.tt", engine.cachePrefix, engine.tableWidth, engine.tableHeight, engine.tableWinLength);
+}
+
+static void SaveCache(Engine& engine) noexcept
+{
+	//nothing searched since it was loaded or cleared, so the file already has it
+	if (engine.cachePrefix[0] == '\0' || engine.table.probes == 0)
+		return;
+
+	char path[1100];
+	CachePath(engine, path);
+	if (!TTCacheSave(engine.table, path, engine.tableWidth, engine.tableHeight, engine.tableWinLength))
+		Reply(engine, "info string unable to write %s\n", path);
+}
+
+//moves the table over to the current board size, from its file when there's one saved
+static void LoadCache(Engine& engine) noexcept
+{
+	engine.tableWidth = engine.board.width;
+	engine.tableHeight = engine.board.height;
+	engine.tableWinLength = engine.board.winLength;
+
+	char path[1100];
+	CachePath(engine, path);
+	if (engine.cachePrefix[0] != '\0' && TTCacheMap(engine.table, path, engine.tableWidth, engine.tableHeight, engine.tableWinLength, true))
+		Reply(engine, "info string cache %s %zu entries\n", path, TTSize(engine.table));
+	else
+		TTClear(engine.table);
+}
+
+static void HandlePosition(Engine& engine) noexcept
+{
+	if (engine.tokenCount < 4)
+	{
+		Reply(engine, "info string position needs width height k\n");
+		return;
+	}
+
+	int width = atoi(engine.tokens[1]);
+	int height = atoi(engine.tokens[2]);
+	int winLength = atoi(engine.tokens[3]);
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1)
+	{
+		Reply(engine, "info string bad board size\n");
+		return;
+	}
+
+	BoardInit(engine.board, width, height, winLength);
+
+	if (width != engine.tableWidth || height != engine.tableHeight || winLength != engine.tableWinLength)
+	{
+		SaveCache(engine);
+		LoadCache(engine);
+	}
+
+	if (!TokenIs(engine, 4, "moves"))
+		return;
+
+	for (int i = 5; i < engine.tokenCount; i++)
+	{
+		int cell = ParseMove(engine.board, engine.tokens[i]);
+		if (cell < 0 || engine.board.cells[cell] != PieceNone || BoardLastMoveWon(engine.board))
+		{
+			Reply(engine, "info string illegal move %s\n", engine.tokens[i]);
+			return;
+		}
+		BoardPlay(engine.board, cell);
+	}
+}
+
+static void ReportInfo(const SearchInfo& info, void* context) noexcept
+{
+	Engine& engine = *(Engine*)context;
+
+	char move[16];
+	FormatMove(engine.board, info.bestMove, move);
+
+	uint64_t nps = info.elapsedNs > 0 ? info.nodes * 1'000'000'000ULL / (uint64_t)info.elapsedNs : 0;
+
+	if (info.score > DecisiveScore || info.score < -DecisiveScore)
+	{
+		//plies to the end of the game, turned into the side to move's own moves like uci does
+		int plies = WinScore - (info.score > 0 ? info.score : -info.score);
+		int moves = (plies + 1) / 2;
+		Reply(engine, "info depth %d score mate %d nodes %llu nps %llu time %lld pv %s\n",
+			info.depth, info.score > 0 ? moves : -moves, (unsigned long long)info.nodes, (unsigned long long)nps, (long long)(info.elapsedNs / 1'000'000), move);
+	}
+	else
+	{
+		Reply(engine, "info depth %d score cp %d nodes %llu nps %llu time %lld pv %s\n",
+			info.depth, info.score, (unsigned long long)info.nodes, (unsigned long long)nps, (long long)(info.elapsedNs / 1'000'000), move);
+	}
+}
+
+static void HandleGo(Engine& engine) noexcept
+{
+	SearchLimits limits =
+	{
+		.threatNodes = engine.threatNodes,
+		.onInfo = ReportInfo,
+		.infoContext = &engine
+	};
+
+	for (int i = 1; i + 1 < engine.tokenCount; i += 2)
+	{
+		if (TokenIs(engine, i, "depth"))
+			limits.maxDepth = atoi(engine.tokens[i + 1]);
+		else if (TokenIs(engine, i, "nodes"))
+			limits.maxNodes = strtoull(engine.tokens[i + 1], nullptr, 10);
+		else if (TokenIs(engine, i, "movetime"))
+			limits.maxTimeNs = atoll(engine.tokens[i + 1]) * 1'000'000;
+		else if (TokenIs(engine, i, "seed"))
+			limits.seed = (uint32_t)strtoul(engine.tokens[i + 1], nullptr, 10);
+	}
+
+	char move[16];
+
+	if (BoardIsFull(engine.board) || BoardLastMoveWon(engine.board))
+	{
+		FormatMove(engine.board, -1, move);
+		Reply(engine, "bestmove %s\n", move);
+		return;
+	}
+
+	SearchResult result = SearchBestMove(engine.board, limits, &engine.table);
+
+	FormatMove(engine.board, result.bestMove, move);
+	Reply(engine, "bestmove %s\n", move);
+}
+
+static void HandleSetOption(Engine& engine) noexcept
+{
+	//setoption name <name> value <value>
+	if (engine.tokenCount < 5 || !TokenIs(engine, 1, "name") || !TokenIs(engine, 3, "value"))
+	{
+		Reply(engine, "info string setoption name <name> value <value>\n");
+		return;
+	}
+
+	if (TokenIs(engine, 2, "Hash"))
+	{
+		size_t megabytes = (size_t)atoll(engine.tokens[4]);
+		size_t entries = 1;
+		while (entries * 2 * sizeof(TTEntry) <= megabytes * 1024 * 1024)
+			entries *= 2;
+		TTResize(engine.table, entries);
+	}
+	else if (TokenIs(engine, 2, "Threats"))
+	{
+		engine.threatNodes = strtoull(engine.tokens[4], nullptr, 10);
+	}
+	else if (TokenIs(engine, 2, "CacheFile"))
+	{
+		//the rest of the line, so the path may have spaces in it
+		char* end = (char*)engine.tokens[engine.tokenCount - 1] + strlen(engine.tokens[engine.tokenCount - 1]);
+		for (char* cursor = (char*)engine.tokens[4]; cursor < end; cursor++)
+			if (*cursor == '\0')
+				*cursor = ' ';
+
+		snprintf(engine.cachePrefix, sizeof(engine.cachePrefix), "%s", engine.tokens[4]);
+		LoadCache(engine);
+	}
+	else
+	{
+		Reply(engine, "info string unknown option %s\n", engine.tokens[2]);
+	}
+}
+
+static void HandleDisplay(Engine& engine) noexcept
+{
+	const Board& board = engine.board;
+
+	for (int y = board.height - 1; y >= 0; y--)
+	{
+		char row[MaxBoardWidth + 2];
+		for (int x = 0; x < board.width; x++)
+			row[x] = ".OX"[board.cells[y * board.width + x]];
+		row[board.width] = '\n';
+		row[board.width + 1] = '\0';
+		Reply(engine, "%s", row);
+	}
+}
+
+static void HandleLine(Engine& engine, char* line) noexcept
+{
+	engine.tokenCount = 0;
+
+	for (char* cursor = line; *cursor != '\0' && engine.tokenCount < MaxTokens;)
+	{
+		while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+			*cursor++ = '\0';
+		if (*cursor == '\0')
+			break;
+
+		engine.tokens[engine.tokenCount++] = cursor;
+		while (*cursor != '\0' && *cursor != ' ' && *cursor != '\t' && *cursor != '\r')
+			cursor++;
+	}
+
+	if (engine.tokenCount == 0)
+		return;
+
+	if (TokenIs(engine, 0, "position"))
+		HandlePosition(engine);
+	else if (TokenIs(engine, 0, "go"))
+		HandleGo(engine);
+	else if (TokenIs(engine, 0, "isready"))
+		Reply(engine, "readyok\n");
+	else if (TokenIs(engine, 0, "newgame") || TokenIs(engine, 0, "ucinewgame"))
+	{
+		if (engine.cachePrefix[0] != '\0')
+			SaveCache(engine);
+		else
+			TTClear(engine.table);
+	}
+	else if (TokenIs(engine, 0, "setoption"))
+		HandleSetOption(engine);
+	else if (TokenIs(engine, 0, "d"))
+		HandleDisplay(engine);
+	else if (TokenIs(engine, 0, "uci"))
+		Reply(engine, "id name TicTacToe\nid author badasahog\noption name Hash type spin default 16 min 1 max 4096\noption name Threats type spin default 4096 min 0 max 100000000\noption name CacheFile type string default <empty>\nuciok\n");
+	else if (TokenIs(engine, 0, "quit"))
+		engine.quit = true;
+	else if (!TokenIs(engine, 0, "stop"))
+		Reply(engine, "info string unknown command %s\n", engine.tokens[0]);
+}
+
+int main()
+{
+	static Engine engine;
+
+	BoardInit(engine.board, 3, 3, 3);
+	TTResize(engine.table, (16 * 1024 * 1024) / sizeof(TTEntry));
+
+	while (!engine.quit)
+	{
+#ifdef _WIN32
+		int received = _read(0, engine.input + engine.inputLength, (unsigned)(InputBufferSize - 1 - engine.inputLength));
+#else
+		ssize_t received = read(0, engine.input + engine.inputLength, InputBufferSize - 1 - engine.inputLength);
+#endif
+		if (received <= 0)
+			break;
+
+		engine.inputLength += (size_t)received;
+
+		//every complete line in the batch, the partial one at the end waits for the next read
+		char* start = engine.input;
+		char* end = engine.input + engine.inputLength;
+		while (!engine.quit)
+		{
+			char* newline = (char*)memchr(start, '\n', (size_t)(end - start));
+			if (newline == nullptr)
+				break;
+			*newline = '\0';
+			HandleLine(engine, start);
+			start = newline + 1;
+		}
+
+		engine.inputLength = (size_t)(end - start);
+		memmove(engine.input, start, engine.inputLength);
+
+		//a line longer than the whole buffer can never complete
+		if (engine.inputLength == InputBufferSize - 1)
+		{
+			Reply(engine, "info string line too long\n");
+			engine.inputLength = 0;
+		}
+
+		Flush(engine);
+	}
+
+	//a last line without a newline
+	if (!engine.quit && engine.inputLength > 0)
+	{
+		engine.input[engine.inputLength] = '\0';
+		HandleLine(engine, engine.input);
+	}
+
+	SaveCache(engine);
+	Flush(engine);
+	return EXIT_SUCCESS;
+}
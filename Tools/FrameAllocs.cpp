@@ -0,0 +1,267 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//runs the window's own frame, GameHostFrame, without the window: input drained from the queue, the game timer advanced,
+//the game moved on, pondering started and the frame rendered, with every heap allocation on any thread counted.
+//after a warm up, any allocation is a failure.
+//scores start high enough that formatting them into a std::wstring wouldn't fit in the small string buffer
+//build: g++ -std=c++20 -O2 -pthread Tools/FrameAllocs.cpp -o frameallocs
+
+#include "../GameHost.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+//the ponder worker allocates from its own thread
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	if (void* memory = malloc(size != 0 ? size : 1))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	allocations++;
+	return malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	allocations++;
+	size_t bytes = (size + (size_t)alignment - 1) / (size_t)alignment * (size_t)alignment;
+#ifdef _WIN32
+	if (void* memory = _aligned_malloc(bytes != 0 ? bytes : (size_t)alignment, (size_t)alignment))
+#else
+	if (void* memory = aligned_alloc((size_t)alignment, bytes != 0 ? bytes : (size_t)alignment))
+#endif
+		return memory;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return operator new(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+void operator delete[](void* memory, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
+
+//takes the draws and does nothing with them but fold them into a checksum, so nothing is optimised away
+struct NullBackend final : RenderBackend
+{
+	uint64_t checksum = 0;
+
+	void Fold(float value) noexcept { checksum = checksum * 31 + (uint64_t)(int64_t)(value * 16); }
+
+	void BeginFrame() noexcept override {}
+	void EndFrame() noexcept override {}
+	void Clear() noexcept override {}
+	void FillRect(const RenderRect& rect, RenderColor color) noexcept override { Fold(rect.left + rect.bottom + (float)color); }
+	void DrawSegment(RenderPoint from, RenderPoint to, RenderColor color, float width) noexcept override { Fold(from.x + to.y + width + (float)color); }
+	void DrawCircle(RenderPoint centre, float radius, RenderColor color, float) noexcept override { Fold(centre.x + radius + (float)color); }
+
+	void DrawLabel(const wchar_t* text, uint32_t length, RenderFont font, const RenderRect& area, RenderColor) noexcept override
+	{
+		for (uint32_t i = 0; i < length; i++)
+			checksum = checksum * 31 + (uint64_t)text[i];
+		Fold(area.top + (float)font);
+	}
+
+	void BeginLayer(RenderLayer) noexcept override {}
+	void EndLayer() noexcept override {}
+	void DrawLayer(RenderLayer layer) noexcept override { Fold((float)layer); }
+};
+
+[[nodiscard]]
+static RenderPoint Centre(const RenderRect& rect) noexcept
+{
+	return { (rect.left + rect.right) / 2, (rect.top + rect.bottom) / 2 };
+}
+
+int main(int argc, char** argv)
+{
+	int seconds = argc > 1 ? atoi(argv[1]) : 3600;
+	int fps = argc > 2 ? atoi(argv[2]) : 60;
+	int warmupSeconds = argc > 3 ? atoi(argv[3]) : 30;
+	int64_t startingScore = argc > 4 ? strtoll(argv[4], nullptr, 10) : 1'234'567'890;
+
+	if (seconds < 1 || fps < 1 || warmupSeconds < 0 || warmupSeconds >= seconds)
+	{
+		fprintf(stderr, "usage: %s [seconds] [fps] [warmupSeconds] [startingScore]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	//set up the way WinMain does, everything sized before the first frame
+	std::unique_ptr<GameHost> host = std::make_unique<GameHost>();
+	GameHostInit(*host, 1, 0, 1 << 12);
+	TTResize(host->CPUTable, 1 << 12);
+	host->game.playerScore = startingScore;
+	host->game.CPUScore = startingScore;
+	ComputeLayout(host->layout, 576, 576);
+
+	NullBackend backend;
+
+	int64_t frameNs = 1'000'000'000LL / fps;
+	int64_t endNs = seconds * 1'000'000'000LL;
+	int64_t warmupNs = warmupSeconds * 1'000'000'000LL;
+
+	uint64_t random = 0xF4A3E5ull;
+	uint64_t frames = 0;
+	uint64_t warmupAllocations = 0;
+	uint64_t allocatingFrames = 0;
+	uint64_t steadyAllocations = 0;
+	uint64_t worstFrameAllocations = 0;
+	int64_t firstAllocatingNs = -1;
+	int64_t nextInputNs = 0;
+	int resizes = 0;
+
+	for (int64_t nowNs = 0; nowNs < endNs; nowNs += frameNs)
+	{
+		//a player who moves to a square and clicks it every so often, goes back to the menu now and then,
+		//and drags the window to another size once in a while
+		if (nowNs >= nextInputNs)
+		{
+			uint64_t choice = SplitMix64(random);
+			RenderPoint target;
+			InputKind kind = InputClick;
+			uint32_t key = 0;
+
+			if (host->game.gameState == 0)
+			{
+				target = Centre(host->layout.playHitArea);
+			}
+			else if (choice % 97 == 0)
+			{
+				target = {};
+				kind = InputKey;
+				key = InputKeyEscape;
+			}
+			else
+			{
+				RenderPoint corner = host->layout.squarePoints[(choice >> 8) % 9];
+				target = { corner.x + host->layout.squareSize / 2, corner.y + host->layout.squareSize / 2 };
+			}
+
+			InputPush(host->input, InputEvent{ .timeNs = nowNs, .x = target.x, .y = target.y, .key = 0, .kind = InputMove });
+			InputPush(host->input, InputEvent{ .timeNs = nowNs, .x = target.x, .y = target.y, .key = key, .kind = kind });
+			nextInputNs = nowNs + 100'000'000 + (int64_t)((choice >> 16) % 900'000'000);
+
+			if (choice % 61 == 0)
+			{
+				int size = 480 + (int)((choice >> 40) % 4) * 96;
+				ComputeLayout(host->layout, size, size);
+				InvalidateLayers(host->layerCache);
+				resizes++;
+			}
+		}
+
+		uint64_t before = allocations;
+		(void)GameHostFrame(*host, backend, nowNs);
+		uint64_t allocated = allocations - before;
+		frames++;
+
+		if (nowNs < warmupNs)
+		{
+			warmupAllocations += allocated;
+			continue;
+		}
+
+		if (allocated != 0)
+		{
+			allocatingFrames++;
+			steadyAllocations += allocated;
+			if (allocated > worstFrameAllocations)
+				worstFrameAllocations = allocated;
+			if (firstAllocatingNs < 0)
+				firstAllocatingNs = nowNs;
+		}
+	}
+
+	printf("frameallocs: %llu frames at %d fps, %d resizes, scores %lld - %lld (checksum %016llx)\n",
+		(unsigned long long)frames,
+		fps,
+		resizes,
+		(long long)host->game.playerScore,
+		(long long)host->game.CPUScore,
+		(unsigned long long)backend.checksum);
+	printf("  warm up (first %d s): %llu allocations\n", warmupSeconds, (unsigned long long)warmupAllocations);
+	printf("  after:               %llu allocations in %llu frames, at most %llu in one frame\n",
+		(unsigned long long)steadyAllocations,
+		(unsigned long long)allocatingFrames,
+		(unsigned long long)worstFrameAllocations);
+
+	if (allocatingFrames != 0)
+	{
+		printf("FAILED: the first allocating frame was at %.3f s\n", firstAllocatingNs / 1e9);
+		return EXIT_FAILURE;
+	}
+
+	printf("passed: no frame after the warm up allocated\n");
+	return EXIT_SUCCESS;
+}
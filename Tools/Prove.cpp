@@ -0,0 +1,121 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//proves a position won, lost or drawn with df-pn in a fixed amount of memory, picking up from a checkpoint if one is given and exists
+//build: g++ -std=c++20 -O2 Tools/Prove.cpp -o prove
+
+#include "../Board.h"
+#include "../DfPn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+[[nodiscard]]
+static double PeakResidentMegabytes() noexcept
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = { .cb = sizeof(counters) };
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0.0;
+	return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0.0;
+	return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		fprintf(stderr, "usage: %s width height k [tableMB] [checkpoint|-] [maxNodes] [moves...]\n", argv[0]);
+		fprintf(stderr, "  moves are cell indexes played alternately from an empty board, X first\n");
+		return EXIT_FAILURE;
+	}
+
+	int width = atoi(argv[1]);
+	int height = atoi(argv[2]);
+	int winLength = atoi(argv[3]);
+	size_t tableMegabytes = argc > 4 ? (size_t)atoll(argv[4]) : 256;
+	const char* checkpointPath = argc > 5 && argv[5][0] != '-' ? argv[5] : nullptr;
+	uint64_t maxNodes = argc > 6 ? strtoull(argv[6], nullptr, 10) : 0;
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1 || tableMegabytes < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	Board position;
+	BoardInit(position, width, height, winLength);
+	for (int i = 7; i < argc; i++)
+	{
+		int cell = atoi(argv[i]);
+		if (cell < 0 || cell >= width * height || position.cells[cell] != PieceNone || BoardLastMoveWon(position))
+		{
+			fprintf(stderr, "illegal move %s\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+		BoardPlay(position, cell);
+	}
+
+	//a few tens of kilobytes of per-ply hashes, too much for the stack
+	std::unique_ptr<ProofSolver> solver = std::make_unique<ProofSolver>();
+	ProofSolverInit(*solver, position, tableMegabytes * 1024 * 1024);
+
+	if (checkpointPath != nullptr)
+	{
+		solver->checkpointPath = checkpointPath;
+		solver->checkpointInterval = 50'000'000;
+		if (ProofLoadCheckpoint(*solver, checkpointPath))
+			printf("resumed from %s after %llu nodes\n", checkpointPath, (unsigned long long)solver->nodes);
+	}
+
+	printf("%dx%d k=%d, %d moves played, %zu MB table (%zu entries), %d symmetries\n",
+		width, height, winLength, position.moveCount, tableMegabytes, solver->entries.size(), solver->symmetryCount);
+
+	uint64_t startNodes = solver->nodes;
+	solver->maxNodes = maxNodes != 0 ? startNodes + maxNodes : 0;
+	auto start = std::chrono::steady_clock::now();
+
+	ProofOutcome outcome = ProofClassify(*solver);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t nodes = solver->nodes - startNodes;
+
+	static const char* OutcomeNames[] = { "unknown (node limit)", "win", "loss", "draw" };
+	printf("result: %s for the side to move\n", OutcomeNames[outcome]);
+	printf("%llu proof nodes in %.2f s: %.0f nodes/sec\n", (unsigned long long)nodes, seconds, nodes / (seconds > 0 ? seconds : 1e-9));
+	printf("peak RSS %.1f MB\n", PeakResidentMegabytes());
+
+	if (checkpointPath != nullptr)
+	{
+		if (!ProofSaveCheckpoint(*solver, checkpointPath))
+		{
+			fprintf(stderr, "unable to write %s\n", checkpointPath);
+			return EXIT_FAILURE;
+		}
+		printf("%d checkpoints written to %s\n", solver->checkpointsWritten + 1, checkpointPath);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//replays an input trace through the window's own frame, GameHostFrame, without a window, on a virtual clock so every run
+//ends the same way. pondering is off, the CPU's replies would otherwise depend on how far the ponder search got.
+//traces come from starting the game with a file path on the command line, or are made up here
+//build: g++ -std=c++20 -O2 -pthread Tools/Replay.cpp -o replay
+
+#include "../GameHost.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+[[nodiscard]]
+static int64_t NowNs() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+[[nodiscard]]
+static bool ReadTrace(const char* path, std::vector<InputEvent>& trace) noexcept
+{
+	FILE* file = fopen(path, "r");
+	if (file == nullptr)
+		return false;
+
+	InputEvent event;
+	while (InputTraceRead(file, event))
+		trace.push_back(event);
+
+	fclose(file);
+	return true;
+}
+
+//someone who clicks play, then keeps moving to a random square and clicking it, pressing escape now and then
+static void MakeTrace(std::vector<InputEvent>& trace, const SceneLayout& layout, int seconds, uint64_t seed) noexcept
+{
+	int64_t timeNs = 0;
+	float x = layout.width / 2.f;
+	float y = layout.height / 2.f;
+
+	auto moveTo = [&](float targetX, float targetY, int steps) noexcept
+	{
+		float startX = x;
+		float startY = y;
+		for (int step = 1; step <= steps; step++)
+		{
+			//mice report at around 125 Hz
+			timeNs += 8'000'000;
+			x = startX + (targetX - startX) * step / steps;
+			y = startY + (targetY - startY) * step / steps;
+			trace.push_back({ .timeNs = timeNs, .x = x, .y = y, .key = 0, .kind = InputMove });
+		}
+	};
+
+	auto click = [&]() noexcept
+	{
+		timeNs += 60'000'000;
+		trace.push_back({ .timeNs = timeNs, .x = x, .y = y, .key = 0, .kind = InputClick });
+	};
+
+	auto pressPlay = [&]() noexcept
+	{
+		moveTo((layout.playHitArea.left + layout.playHitArea.right) / 2, (layout.playHitArea.top + layout.playHitArea.bottom) / 2, 20);
+		click();
+	};
+
+	pressPlay();
+
+	while (timeNs < seconds * 1'000'000'000LL)
+	{
+		uint64_t choice = SplitMix64(seed);
+
+		if (choice % 200 == 0)
+		{
+			timeNs += 500'000'000;
+			trace.push_back({ .timeNs = timeNs, .x = x, .y = y, .key = InputKeyEscape, .kind = InputKey });
+			pressPlay();
+			continue;
+		}
+
+		int square = (int)(choice >> 8) % 9;
+		RenderPoint corner = layout.squarePoints[square];
+		moveTo(corner.x + layout.squareSize / 2, corner.y + layout.squareSize / 2, 10 + (int)(choice >> 16) % 30);
+		click();
+
+		//waits a while either way, clicks on taken squares or while the CPU is thinking do nothing
+		timeNs += (int64_t)(choice >> 24) % 1'500'000'000;
+	}
+}
+
+struct ReplayResult
+{
+	uint64_t frames = 0;
+	uint64_t events = 0;
+	uint64_t moves = 0;
+	int gamesFinished = 0;
+	int64_t playerScore = 0;
+	int64_t CPUScore = 0;
+	//folds in every frame that was drawn, equal across runs when the replay is deterministic
+	uint64_t checksum = 0;
+	int64_t frameNs = 0;
+	InputLatencyStats latency;
+};
+
+//takes the draws and does nothing with them but fold them into a checksum
+struct NullBackend final : RenderBackend
+{
+	uint64_t checksum = 0;
+
+	void Fold(float value) noexcept { checksum = checksum * 31 + (uint64_t)(int64_t)(value * 16); }
+
+	void BeginFrame() noexcept override {}
+	void EndFrame() noexcept override {}
+	void Clear() noexcept override {}
+	void FillRect(const RenderRect& rect, RenderColor color) noexcept override { Fold(rect.left + rect.top + rect.right + rect.bottom + (float)color); }
+	void DrawSegment(RenderPoint from, RenderPoint to, RenderColor color, float width) noexcept override { Fold(from.x + from.y + to.x + to.y + width + (float)color); }
+	void DrawCircle(RenderPoint centre, float radius, RenderColor color, float) noexcept override { Fold(centre.x + centre.y + radius + (float)color); }
+
+	void DrawLabel(const wchar_t* text, uint32_t length, RenderFont font, const RenderRect& area, RenderColor) noexcept override
+	{
+		for (uint32_t i = 0; i < length; i++)
+			checksum = checksum * 31 + (uint64_t)text[i];
+		Fold(area.left + area.top + (float)font);
+	}
+
+	void BeginLayer(RenderLayer) noexcept override {}
+	void EndLayer() noexcept override {}
+	void DrawLayer(RenderLayer layer) noexcept override { Fold((float)layer); }
+};
+
+//pushes each event through the queue before the first frame at or after its time, then runs that frame
+static void Replay(const std::vector<InputEvent>& trace, const SceneLayout& layout, int64_t frameNs, uint64_t seed, ReplayResult& result)
+{
+	//the queue and the ponder table are a lot of bytes for the stack
+	std::unique_ptr<GameHost> host = std::make_unique<GameHost>();
+	GameHostInit(*host, seed, 0);
+	host->ponder = false;
+	host->layout = layout;
+
+	GameSession& session = host->game;
+	NullBackend backend;
+
+	size_t next = 0;
+	int64_t endNs = trace.back().timeNs + GameFinishedNs + frameNs;
+
+	for (int64_t nowNs = 0; nowNs <= endNs && !session.exitRequested; nowNs += frameNs)
+	{
+		while (next < trace.size() && trace[next].timeNs <= nowNs)
+		{
+			if (!InputPush(host->input, trace[next]))
+				break;
+			next++;
+		}
+
+		int before = session.gameState;
+		int64_t start = NowNs();
+
+		int handled = GameHostFrame(*host, backend, nowNs);
+
+		result.frameNs += NowNs() - start;
+
+		if (before == 1 && session.gameState != 1)
+			result.moves++;
+		if (before == 3 && session.gameState == 1)
+			result.gamesFinished++;
+
+		//the frame is presented at the end of its interval
+		for (int i = 0; i < handled; i++)
+			InputLatencyRecord(result.latency, nowNs + frameNs - host->eventTimes[i]);
+		result.events += handled;
+
+		result.checksum = result.checksum * 31 + (uint64_t)session.gameState;
+		result.frames++;
+	}
+
+	result.checksum ^= backend.checksum;
+	result.playerScore = session.playerScore;
+	result.CPUScore = session.CPUScore;
+}
+
+//the window thread's side on its own thread, to see what the queue itself costs
+static void BenchQueue(const std::vector<InputEvent>& trace, int repeat) noexcept
+{
+	std::unique_ptr<InputQueue> queue = std::make_unique<InputQueue>();
+	uint64_t total = (uint64_t)trace.size() * repeat;
+	InputLatencyStats latency;
+
+	int64_t start = NowNs();
+
+	std::thread producer([&]() noexcept
+	{
+		for (int round = 0; round < repeat; round++)
+		{
+			for (InputEvent event : trace)
+			{
+				event.timeNs = NowNs();
+				while (!InputPush(*queue, event))
+					std::this_thread::yield();
+			}
+		}
+	});
+
+	uint64_t received = 0;
+	InputEvent event;
+	while (received < total)
+	{
+		if (!InputPop(*queue, event))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		if ((received & 63) == 0)
+			InputLatencyRecord(latency, NowNs() - event.timeNs);
+		received++;
+	}
+
+	producer.join();
+
+	double seconds = (NowNs() - start) / 1e9;
+	printf("queue: %llu events across threads in %.3f s, %.1f M events/sec, push to pop p50 %.2f us p99 %.2f us\n",
+		(unsigned long long)total,
+		seconds,
+		total / seconds / 1e6,
+		InputLatencyPercentile(latency, .5) / 1e3,
+		InputLatencyPercentile(latency, .99) / 1e3);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s trace.txt|synthetic [fps] [windowSize] [seed] [syntheticSeconds]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int fps = argc > 2 ? atoi(argv[2]) : 60;
+	int windowSize = argc > 3 ? atoi(argv[3]) : 576;
+	uint64_t seed = argc > 4 ? strtoull(argv[4], nullptr, 10) : 1;
+	int syntheticSeconds = argc > 5 ? atoi(argv[5]) : 600;
+
+	if (fps < 1 || windowSize < 64 || syntheticSeconds < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	SceneLayout layout;
+	ComputeLayout(layout, windowSize, windowSize);
+
+	std::vector<InputEvent> trace;
+	if (strcmp(argv[1], "synthetic") == 0)
+	{
+		MakeTrace(trace, layout, syntheticSeconds, seed);
+	}
+	else if (!ReadTrace(argv[1], trace))
+	{
+		fprintf(stderr, "unable to read %s\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	if (trace.empty())
+	{
+		fprintf(stderr, "empty trace\n");
+		return EXIT_FAILURE;
+	}
+
+	int64_t frameNs = 1'000'000'000LL / fps;
+	printf("replay: %zu events over %.1f s, %d fps, %dx%d window\n", trace.size(), trace.back().timeNs / 1e9, fps, windowSize, windowSize);
+
+	ReplayResult first;
+	ReplayResult second;
+	Replay(trace, layout, frameNs, seed, first);
+	Replay(trace, layout, frameNs, seed, second);
+
+	printf("%llu frames, %llu events, %llu moves, %d games finished, score %lld - %lld\n",
+		(unsigned long long)first.frames,
+		(unsigned long long)first.events,
+		(unsigned long long)first.moves,
+		first.gamesFinished,
+		(long long)first.playerScore,
+		(long long)first.CPUScore);
+	printf("input to frame latency: mean %.2f ms, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+		first.latency.totalNs / 1e6 / first.latency.samples,
+		InputLatencyPercentile(first.latency, .5) / 1e6,
+		InputLatencyPercentile(first.latency, .99) / 1e6,
+		first.latency.maxNs / 1e6);
+	printf("frame %.2f us (logic and draw calls)\n", first.frameNs / 1e3 / first.frames);
+
+	bool deterministic = first.checksum == second.checksum && first.frames == second.frames;
+	printf("second run %s (checksum %016llx)\n", deterministic ? "identical" : "DIFFERENT", (unsigned long long)first.checksum);
+
+	BenchQueue(trace, (int)(10'000'000 / trace.size()) + 1);
+
+	return deterministic ? EXIT_SUCCESS : EXIT_FAILURE;
+}
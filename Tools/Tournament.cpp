@@ -0,0 +1,514 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//plays CPU configurations against each other on every core. each random opening is played twice with the colours swapped,
+//and with two players a sequential probability ratio test stops the match as soon as the result is settled
+//build: g++ -std=c++20 -O2 -pthread Tools/Tournament.cpp -o tournament
+
+#include "../Board.h"
+#include "../Search.h"
+#include "../NTuple.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+struct PlayerConfig
+{
+	char name[32];
+	SearchLimits limits;
+	size_t tableEntries = 1 << 16;
+	//plays any empty cell at random, like the game did before it had a search
+	bool random = false;
+};
+
+//name:key=value,key=value,... with keys depth, nodes, movetime (ms), threats, seed, tt (entries), eval (lines|ntuple) and random
+[[nodiscard]]
+static bool ParsePlayer(const char* spec, PlayerConfig& config, const char*& weightsPath) noexcept
+{
+	config = PlayerConfig{};
+
+	const char* colon = strchr(spec, ':');
+	size_t nameLength = colon != nullptr ? (size_t)(colon - spec) : strlen(spec);
+	if (nameLength == 0 || nameLength >= sizeof(config.name))
+		return false;
+	memcpy(config.name, spec, nameLength);
+	config.name[nameLength] = '\0';
+
+	if (colon == nullptr)
+		return true;
+
+	for (const char* option = colon + 1; *option != '\0';)
+	{
+		const char* end = strchr(option, ',');
+		if (end == nullptr)
+			end = option + strlen(option);
+
+		const char* equals = (const char*)memchr(option, '=', (size_t)(end - option));
+		size_t keyLength = (size_t)((equals != nullptr ? equals : end) - option);
+		const char* value = equals != nullptr ? equals + 1 : "";
+
+		auto keyIs = [&](const char* key) noexcept { return keyLength == strlen(key) && memcmp(option, key, keyLength) == 0; };
+
+		if (keyIs("depth"))
+			config.limits.maxDepth = atoi(value);
+		else if (keyIs("nodes"))
+			config.limits.maxNodes = strtoull(value, nullptr, 10);
+		else if (keyIs("movetime"))
+			config.limits.maxTimeNs = atoll(value) * 1'000'000;
+		else if (keyIs("threats"))
+			config.limits.threatNodes = strtoull(value, nullptr, 10);
+		else if (keyIs("seed"))
+			config.limits.seed = (uint32_t)strtoul(value, nullptr, 10);
+		else if (keyIs("tt"))
+			config.tableEntries = (size_t)strtoull(value, nullptr, 10);
+		else if (keyIs("random"))
+			config.random = true;
+		else if (keyIs("eval") && strncmp(value, "lines", 5) == 0)
+			config.limits.evaluate = nullptr;
+		else if (keyIs("eval") && strncmp(value, "ntuple", 6) == 0)
+			config.limits.evaluate = EvaluateNTuple;
+		else if (keyIs("weights"))
+			weightsPath = value;
+		else
+			return false;
+
+		option = *end == ',' ? end + 1 : end;
+	}
+
+	//the table is indexed with a mask
+	if (config.tableEntries == 0 || (config.tableEntries & (config.tableEntries - 1)) != 0)
+		return false;
+
+	return true;
+}
+
+struct Opening
+{
+	int length;
+	int16_t moves[MaxBoardCells];
+};
+
+//a few random moves near the centre, redrawn until nobody has won
+static void MakeOpening(Opening& opening, int width, int height, int winLength, int plies, uint64_t seed) noexcept
+{
+	Board board;
+
+	while (true)
+	{
+		BoardInit(board, width, height, winLength);
+		opening.length = 0;
+
+		bool decided = false;
+		for (int i = 0; i < plies && !BoardIsFull(board); i++)
+		{
+			int16_t moves[MaxBoardCells];
+			int moveCount = GenerateMoves(board, moves);
+			int move = moves[SplitMix64(seed) % (uint64_t)moveCount];
+
+			BoardPlay(board, move);
+			opening.moves[opening.length++] = (int16_t)move;
+
+			if (BoardLastMoveWon(board))
+			{
+				decided = true;
+				break;
+			}
+		}
+
+		if (!decided)
+			return;
+	}
+}
+
+[[nodiscard]]
+static int PickMove(Board& board, const PlayerConfig& config, TranspositionTable& table, uint64_t& rng) noexcept
+{
+	if (config.random)
+	{
+		int empty[MaxBoardCells];
+		int emptyCount = 0;
+		for (int cell = 0; cell < BoardCellCount(board); cell++)
+		{
+			if (board.cells[cell] == PieceNone)
+				empty[emptyCount++] = cell;
+		}
+		return empty[SplitMix64(rng) % (uint64_t)emptyCount];
+	}
+
+	return SearchBestMove(board, config.limits, &table).bestMove;
+}
+
+//1 when first wins, 0 for a draw, -1 when second wins. first moves first
+[[nodiscard]]
+static int PlayGame(const Opening& opening, int width, int height, int winLength,
+	const PlayerConfig& first, TranspositionTable& firstTable,
+	const PlayerConfig& second, TranspositionTable& secondTable,
+	uint64_t& rng, uint64_t& moves) noexcept
+{
+	Board board;
+	BoardInit(board, width, height, winLength);
+
+	for (int i = 0; i < opening.length; i++)
+		BoardPlay(board, opening.moves[i]);
+
+	TTClear(firstTable);
+	TTClear(secondTable);
+
+	int8_t firstPiece = board.toMove;
+
+	while (!BoardIsFull(board))
+	{
+		bool firstToMove = board.toMove == firstPiece;
+		int move = firstToMove
+			? PickMove(board, first, firstTable, rng)
+			: PickMove(board, second, secondTable, rng);
+
+		BoardPlay(board, move);
+		moves++;
+
+		if (BoardLastMoveWon(board))
+			return firstToMove ? 1 : -1;
+	}
+
+	return 0;
+}
+
+struct Matchup
+{
+	int first;
+	int second;
+	//pairs of games scored from first's side: 0, 0.5, 1, 1.5 or 2 points out of 2
+	uint64_t pentanomial[5] = {};
+	uint64_t wins = 0;
+	uint64_t draws = 0;
+	uint64_t losses = 0;
+};
+
+struct MatchStats
+{
+	uint64_t pairs;
+	double score;
+	//per pair, with the pair's score scaled to 0..1
+	double variance;
+};
+
+//prior adds that many pairs of every outcome to the variance, so the first few pairs, which often all score the same,
+//can't make the ratio test look certain
+[[nodiscard]]
+static MatchStats StatsFor(const Matchup& matchup, double prior = 0) noexcept
+{
+	MatchStats stats = {};
+	for (int i = 0; i < 5; i++)
+		stats.pairs += matchup.pentanomial[i];
+
+	if (stats.pairs == 0)
+		return stats;
+
+	for (int i = 0; i < 5; i++)
+		stats.score += matchup.pentanomial[i] * (i / 4.0);
+	stats.score /= stats.pairs;
+
+	double mean = stats.score * stats.pairs;
+	for (int i = 0; i < 5; i++)
+		mean += prior * (i / 4.0);
+	mean /= stats.pairs + 5 * prior;
+
+	for (int i = 0; i < 5; i++)
+		stats.variance += (matchup.pentanomial[i] + prior) * (i / 4.0 - mean) * (i / 4.0 - mean);
+	stats.variance /= stats.pairs + 5 * prior;
+
+	return stats;
+}
+
+[[nodiscard]]
+static double EloFromScore(double score) noexcept
+{
+	score = std::fmin(std::fmax(score, 1e-6), 1 - 1e-6);
+	return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+[[nodiscard]]
+static double ScoreFromElo(double elo) noexcept
+{
+	return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+constexpr double SprtPrior = 0.5;
+
+//log likelihood ratio of elo1 over elo0, with the normal approximation to the pair scores
+[[nodiscard]]
+static double LogLikelihoodRatio(const MatchStats& stats, double elo0, double elo1) noexcept
+{
+	if (stats.pairs < 2)
+		return 0.0;
+
+	double variance = stats.variance > 1e-9 ? stats.variance : 1e-9;
+	double score0 = ScoreFromElo(elo0);
+	double score1 = ScoreFromElo(elo1);
+
+	return stats.pairs * (score1 - score0) * (2 * stats.score - score0 - score1) / (2 * variance);
+}
+
+static void PrintMatchup(const std::vector<PlayerConfig>& players, const Matchup& matchup) noexcept
+{
+	MatchStats stats = StatsFor(matchup);
+
+	//with the prior, pairs that all scored the same still leave some variance, so the interval never shrinks to nothing
+	double deviation = std::sqrt(StatsFor(matchup, SprtPrior).variance / (stats.pairs != 0 ? stats.pairs : 1));
+
+	char estimate[64];
+	if (stats.pairs != 0 && (stats.score <= 0 || stats.score >= 1))
+	{
+		//every pair went the same way, so there's no estimate to put a margin around, only a 95% bound on one side
+		bool won = stats.score >= 1;
+		snprintf(estimate, sizeof(estimate), "elo %s %+.1f (one-sided)", won ? ">" : "<", EloFromScore(won ? 1 - 1.645 * deviation : 1.645 * deviation));
+	}
+	else
+	{
+		//95% interval on the mean pair score, mapped through the elo curve
+		double margin = stats.pairs != 0 ? 1.96 * deviation : 0.5;
+		double low = EloFromScore(stats.score - margin);
+		double high = EloFromScore(stats.score + margin);
+		snprintf(estimate, sizeof(estimate), "elo %+7.1f  +/- %5.1f  [%+.1f, %+.1f]", EloFromScore(stats.score), (high - low) / 2, low, high);
+	}
+
+	printf("  %-12s vs %-12s  %6llu games  +%llu =%llu -%llu  %s\n",
+		players[matchup.first].name,
+		players[matchup.second].name,
+		(unsigned long long)(matchup.wins + matchup.draws + matchup.losses),
+		(unsigned long long)matchup.wins,
+		(unsigned long long)matchup.draws,
+		(unsigned long long)matchup.losses,
+		estimate);
+}
+
+int main(int argc, char** argv)
+{
+	int width = 9;
+	int height = 9;
+	int winLength = 5;
+	uint64_t maxPairs = 1000;
+	int openingPlies = 4;
+	int threadCount = (int)std::thread::hardware_concurrency();
+	uint64_t seed = 1;
+	bool sprt = false;
+	double elo0 = 0;
+	double elo1 = 10;
+	double alpha = 0.05;
+	double beta = 0.05;
+	const char* weightsPath = nullptr;
+
+	std::vector<PlayerConfig> players;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-board") == 0 && i + 3 < argc)
+		{
+			width = atoi(argv[++i]);
+			height = atoi(argv[++i]);
+			winLength = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-pairs") == 0 && i + 1 < argc)
+			maxPairs = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-openings") == 0 && i + 1 < argc)
+			openingPlies = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+			threadCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc)
+			seed = strtoull(argv[++i], nullptr, 10);
+		else if (strcmp(argv[i], "-sprt") == 0 && i + 2 < argc)
+		{
+			sprt = true;
+			elo0 = atof(argv[++i]);
+			elo1 = atof(argv[++i]);
+			if (i + 2 < argc && argv[i + 1][0] != '-' && strchr(argv[i + 1], ':') == nullptr && atof(argv[i + 1]) > 0)
+			{
+				alpha = atof(argv[++i]);
+				beta = atof(argv[++i]);
+			}
+		}
+		else
+		{
+			PlayerConfig config;
+			if (argv[i][0] == '-' || !ParsePlayer(argv[i], config, weightsPath))
+			{
+				fprintf(stderr, "bad argument %s\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+			players.push_back(config);
+		}
+	}
+
+	if (players.size() < 2)
+	{
+		fprintf(stderr, "usage: %s [-board w h k] [-pairs n] [-openings plies] [-threads n] [-seed n] [-sprt elo0 elo1 [alpha beta]] player player...\n", argv[0]);
+		fprintf(stderr, "  player is name:key=value,... with keys depth, nodes, movetime (ms), threats, seed, tt (entries, a power of two), eval=lines|ntuple, weights=path and random\n");
+		return EXIT_FAILURE;
+	}
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1 || threadCount < 1 || openingPlies < 0)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	if (sprt && players.size() != 2)
+	{
+		fprintf(stderr, "the sprt needs exactly two players, the candidate first\n");
+		return EXIT_FAILURE;
+	}
+
+	//every ntuple player shares the one network Search can see
+	NTupleNetwork network;
+	for (const PlayerConfig& player : players)
+	{
+		if (player.limits.evaluate != EvaluateNTuple || ActiveNetwork != nullptr)
+			continue;
+
+		if (weightsPath == nullptr || !NTupleLoad(network, weightsPath) || network.width != width || network.height != height || network.winLength != winLength)
+		{
+			fprintf(stderr, "eval=ntuple needs weights=path trained for this board\n");
+			return EXIT_FAILURE;
+		}
+		ActiveNetwork = &network;
+	}
+
+	std::vector<Matchup> matchups;
+	for (int first = 0; first < (int)players.size(); first++)
+	{
+		for (int second = first + 1; second < (int)players.size(); second++)
+			matchups.push_back({ .first = first, .second = second });
+	}
+
+	double lowerBound = std::log(beta / (1 - alpha));
+	double upperBound = std::log((1 - beta) / alpha);
+
+	printf("%dx%d k=%d, %zu players, up to %llu pairs of games from %d-ply openings, %d threads\n",
+		width, height, winLength, players.size(), (unsigned long long)maxPairs, openingPlies, threadCount);
+	if (sprt)
+		printf("sprt elo0 %.1f elo1 %.1f alpha %.3f beta %.3f: llr bounds [%.2f, %.2f]\n", elo0, elo1, alpha, beta, lowerBound, upperBound);
+
+	std::mutex resultsMutex;
+	std::atomic<uint64_t> nextPair = 0;
+	std::atomic<uint64_t> pairsDone = 0;
+	std::atomic<uint64_t> movesPlayed = 0;
+	std::atomic<bool> stop = false;
+	//set under the mutex by whichever thread first crosses a bound, 0 while undecided
+	int verdict = 0;
+	double finalRatio = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&, t]() noexcept
+		{
+			std::vector<TranspositionTable> tables(players.size());
+			for (size_t i = 0; i < players.size(); i++)
+			{
+				if (!players[i].random)
+					TTResize(tables[i], players[i].tableEntries);
+			}
+
+			uint64_t rng = seed * 0x9E3779B97F4A7C15ull + (uint64_t)t;
+			Opening opening;
+
+			while (!stop.load(std::memory_order_relaxed))
+			{
+				uint64_t pair = nextPair.fetch_add(1, std::memory_order_relaxed);
+				if (pair >= maxPairs)
+					break;
+
+				Matchup& matchup = matchups[pair % matchups.size()];
+				const PlayerConfig& first = players[matchup.first];
+				const PlayerConfig& second = players[matchup.second];
+
+				//the opening depends only on the pair, so a rerun with the same seed plays the same positions
+				MakeOpening(opening, width, height, winLength, openingPlies, seed ^ (pair * 0xD1B54A32D192ED03ull));
+
+				uint64_t moves = 0;
+				int firstResult = PlayGame(opening, width, height, winLength, first, tables[matchup.first], second, tables[matchup.second], rng, moves);
+				int secondResult = -PlayGame(opening, width, height, winLength, second, tables[matchup.second], first, tables[matchup.first], rng, moves);
+				movesPlayed.fetch_add(moves, std::memory_order_relaxed);
+
+				std::lock_guard<std::mutex> lock(resultsMutex);
+
+				matchup.pentanomial[firstResult + secondResult + 2]++;
+				for (int result : { firstResult, secondResult })
+				{
+					if (result > 0)
+						matchup.wins++;
+					else if (result == 0)
+						matchup.draws++;
+					else
+						matchup.losses++;
+				}
+				pairsDone.fetch_add(1, std::memory_order_relaxed);
+
+				if (sprt && verdict == 0)
+				{
+					double ratio = LogLikelihoodRatio(StatsFor(matchup, SprtPrior), elo0, elo1);
+					if (ratio >= upperBound || ratio <= lowerBound)
+					{
+						verdict = ratio >= upperBound ? 1 : -1;
+						finalRatio = ratio;
+						stop.store(true, std::memory_order_relaxed);
+					}
+				}
+			}
+		});
+	}
+
+	for (int tick = 1; pairsDone.load(std::memory_order_relaxed) < maxPairs && !stop.load(std::memory_order_relaxed); tick++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		if (tick % 10 != 0)
+			continue;
+
+		uint64_t reported = pairsDone.load(std::memory_order_relaxed);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		if (sprt)
+			printf("  %llu games, %.1f games/sec, llr %.2f\n", (unsigned long long)reported * 2, reported * 2 / seconds, LogLikelihoodRatio(StatsFor(matchups[0], SprtPrior), elo0, elo1));
+		else
+			printf("  %llu games, %.1f games/sec\n", (unsigned long long)reported * 2, reported * 2 / seconds);
+		fflush(stdout);
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t games = pairsDone.load() * 2;
+
+	printf("%llu games (%llu moves) in %.2f s: %.1f games/sec on %d threads\n",
+		(unsigned long long)games, (unsigned long long)movesPlayed.load(), seconds, games / seconds, threadCount);
+
+	for (const Matchup& matchup : matchups)
+		PrintMatchup(players, matchup);
+
+	if (sprt)
+	{
+		double ratio = verdict != 0 ? finalRatio : LogLikelihoodRatio(StatsFor(matchups[0], SprtPrior), elo0, elo1);
+		const char* outcome = verdict > 0 ? "H1 accepted" : verdict < 0 ? "H0 accepted" : "inconclusive";
+		printf("sprt: llr %.2f, %s\n", ratio, outcome);
+	}
+
+	return EXIT_SUCCESS;
+}
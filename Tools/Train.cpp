@@ -0,0 +1,205 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+//trains an n-tuple value function by self-play on every core and saves it for Search to use through EvaluateNTuple
+//build: g++ -std=c++20 -O2 -pthread Tools/Train.cpp -o train
+
+#include "../Board.h"
+#include "../Search.h"
+#include "../NTuple.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if !_HAS_CXX20 && __cplusplus < 202002L
+#error C++20 is required
+#endif
+
+[[nodiscard]]
+static double SecondsSince(std::chrono::steady_clock::time_point start) noexcept
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//side plays greedily on the network, the other side plays uniformly at random
+[[nodiscard]]
+static int PlayVersusRandom(const NTupleNetwork& network, int8_t side, uint64_t& rng) noexcept
+{
+	Board board;
+	BoardInit(board, network.width, network.height, network.winLength);
+
+	while (true)
+	{
+		int16_t moves[MaxBoardCells];
+		int moveCount = GenerateMoves(board, moves);
+		int move = moves[SplitMix64(rng) % moveCount];
+
+		if (board.toMove == side)
+		{
+			float bestDelta = -1e30f;
+			for (int i = 0; i < moveCount; i++)
+			{
+				BoardPlay(board, moves[i]);
+				bool won = BoardLastMoveWon(board);
+				BoardUndo(board);
+
+				float delta = won ? 1e30f : NTupleMoveDelta(network, board, moves[i], side);
+				if (delta > bestDelta)
+				{
+					bestDelta = delta;
+					move = moves[i];
+				}
+			}
+		}
+
+		BoardPlay(board, move);
+
+		if (BoardIsWinningMove(board, move))
+			return board.cells[move] == side ? 1 : -1;
+
+		if (BoardIsFull(board))
+			return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 7)
+	{
+		fprintf(stderr, "usage: %s width height k games threads weights.bin [learningRate]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	int width = atoi(argv[1]);
+	int height = atoi(argv[2]);
+	int winLength = atoi(argv[3]);
+	long long games = atoll(argv[4]);
+	int threadCount = atoi(argv[5]);
+	const char* path = argv[6];
+	float learningRate = argc > 7 ? (float)atof(argv[7]) : 0.01f;
+
+	if (width < 1 || height < 1 || width > MaxBoardWidth || height > MaxBoardWidth || winLength < 1 || threadCount < 1)
+	{
+		fprintf(stderr, "bad arguments\n");
+		return EXIT_FAILURE;
+	}
+
+	NTupleNetwork network;
+	NTupleInit(network, width, height, winLength);
+
+	printf("%dx%d k=%d: %d windows sharing %d tables of %d weights\n", width, height, winLength, network.windowCount, network.tableCount, network.tableSize);
+
+	std::atomic<long long> gamesStarted = 0;
+	std::atomic<long long> movesPlayed = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	//the last worker to finish stops the clock, so the time counted is training and nothing after it
+	std::mutex doneMutex;
+	std::condition_variable allDone;
+	int running = threadCount;
+	auto end = start;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadCount; t++)
+	{
+		threads.emplace_back([&, t]() noexcept
+		{
+			NTupleTrainer trainer;
+			trainer.learningRate = learningRate;
+			trainer.rng = 0x5EED0000ull + t;
+
+			while (gamesStarted.fetch_add(1, std::memory_order_relaxed) < games)
+				movesPlayed.fetch_add(NTupleSelfPlay(network, trainer), std::memory_order_relaxed);
+
+			std::lock_guard<std::mutex> lock(doneMutex);
+			if (--running == 0)
+			{
+				end = std::chrono::steady_clock::now();
+				allDone.notify_one();
+			}
+		});
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(doneMutex);
+		while (!allDone.wait_for(lock, std::chrono::seconds(1), [&]() noexcept { return running == 0; }))
+		{
+			long long done = gamesStarted.load(std::memory_order_relaxed);
+			long long reported = done < games ? done : games;
+			printf("  %lld games, %.0f games/sec\n", reported, reported / SecondsSince(start));
+			fflush(stdout);
+		}
+	}
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	double trainingSeconds = std::chrono::duration<double>(end - start).count();
+	printf("trained %lld games (%lld moves) in %.2f s: %.0f games/sec on %d threads\n",
+		games, movesPlayed.load(), trainingSeconds, games / trainingSeconds, threadCount);
+
+	if (!NTupleSave(network, path))
+	{
+		fprintf(stderr, "unable to write %s\n", path);
+		return EXIT_FAILURE;
+	}
+
+	NTupleNetwork loaded;
+	if (!NTupleLoad(loaded, path))
+	{
+		fprintf(stderr, "unable to read back %s\n", path);
+		return EXIT_FAILURE;
+	}
+
+	//evaluator speed on positions from random games
+	ActiveNetwork = &loaded;
+	std::vector<Board> positions(256);
+	uint64_t rng = 99;
+	for (Board& position : positions)
+	{
+		BoardInit(position, width, height, winLength);
+		int length = (int)(SplitMix64(rng) % (uint64_t)(width * height / 2 + 1));
+		for (int i = 0; i < length; i++)
+		{
+			int16_t moves[MaxBoardCells];
+			int moveCount = GenerateMoves(position, moves);
+			BoardPlay(position, moves[SplitMix64(rng) % moveCount]);
+			if (BoardLastMoveWon(position))
+			{
+				BoardUndo(position);
+				break;
+			}
+		}
+	}
+
+	long long calls = 0;
+	long long checksum = 0;
+	auto evaluateStart = std::chrono::steady_clock::now();
+	while (SecondsSince(evaluateStart) < 1.0)
+	{
+		for (const Board& position : positions)
+			checksum += EvaluateNTuple(position);
+		calls += (long long)positions.size();
+	}
+	printf("evaluator: %.0f calls/sec (checksum %lld)\n", calls / SecondsSince(evaluateStart), checksum);
+
+	int results[2][3] = { { 0 } };
+	for (int game = 0; game < 200; game++)
+	{
+		int8_t side = game % 2 == 0 ? PieceX : PieceO;
+		results[game % 2][PlayVersusRandom(loaded, side, rng) + 1]++;
+	}
+	printf("greedy vs random: first %d-%d-%d, second %d-%d-%d (win-draw-loss)\n",
+		results[0][2], results[0][1], results[0][0], results[1][2], results[1][1], results[1][0]);
+
+	return EXIT_SUCCESS;
+}
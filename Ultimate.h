@@ -0,0 +1,395 @@
+/*
+* (C) 2023 badasahog. All Rights Reserved
+* The above copyright notice shall be included in
+* all copies or substantial portions of the Software.
+*/
+
+#pragma once
+
+#include "Board.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+//ultimate tic tac toe: nine 3x3 boards in a 3x3 grid, and the square a move is played in picks the board the reply goes in.
+//each side's stones on a small board are 9 bits, and which small boards are won or closed is kept up to date move by move,
+//so a move is a few bit operations and a table lookup. moves are small board * 9 + square, both numbered like boardState
+
+//the 8 lines in the same order as GameCheckForWinner's winType, as 9 bit masks
+inline constexpr uint16_t TicTacToeLines[8] =
+{
+	0b000000111, 0b000111000, 0b111000000,
+	0b001001001, 0b010010010, 0b100100100,
+	0b100010001, 0b001010100
+};
+
+//whether any line is complete, for every 9 bit set of squares
+inline constexpr std::array<bool, 512> TicTacToeWins = []
+{
+	std::array<bool, 512> wins = {};
+	for (int squares = 0; squares < 512; squares++)
+		for (uint16_t line : TicTacToeLines)
+			wins[squares] |= (squares & line) == line;
+	return wins;
+}();
+
+//how many squares are in each 9 bit set, std::popcount is a library call on targets without the instruction
+inline constexpr std::array<uint8_t, 512> TicTacToeCounts = []
+{
+	std::array<uint8_t, 512> counts = {};
+	for (int squares = 1; squares < 512; squares++)
+		counts[squares] = (uint8_t)(counts[squares >> 1] + (squares & 1));
+	return counts;
+}();
+
+constexpr uint16_t UltimateAllSquares = 0x1FF;
+
+constexpr int UltimateMoveCount = 81;
+
+//the game's result, besides PieceO and PieceX winning
+constexpr int8_t UltimateOngoing = 0;
+constexpr int8_t UltimateDraw = 3;
+
+struct UltimateBoard
+{
+	//[piece - 1][small board]
+	uint16_t squares[2][9];
+	//small boards won by each side
+	uint16_t won[2];
+	//small boards won or full, nothing more can be played in them
+	uint16_t closed;
+	//the small board the next move has to go in, -1 when any open one will do
+	int8_t next;
+	int8_t toMove;
+	int8_t result;
+	int8_t moveCount;
+};
+
+inline void UltimateInit(UltimateBoard& board) noexcept
+{
+	board = UltimateBoard{};
+	board.next = -1;
+	board.toMove = PieceX;
+	board.result = UltimateOngoing;
+}
+
+//the legal squares of one small board
+[[nodiscard]]
+inline uint16_t UltimateOpenSquares(const UltimateBoard& board, int smallBoard) noexcept
+{
+	if ((board.closed >> smallBoard) & 1)
+		return 0;
+	return (uint16_t)(~(board.squares[0][smallBoard] | board.squares[1][smallBoard]) & UltimateAllSquares);
+}
+
+//the move has to be legal
+inline void UltimatePlay(UltimateBoard& board, int move) noexcept
+{
+	int smallBoard = move / 9;
+	int square = move % 9;
+	int side = board.toMove - 1;
+
+	uint16_t& squares = board.squares[side][smallBoard];
+	squares |= (uint16_t)(1 << square);
+
+	if (TicTacToeWins[squares])
+	{
+		board.won[side] |= (uint16_t)(1 << smallBoard);
+		board.closed |= (uint16_t)(1 << smallBoard);
+
+		if (TicTacToeWins[board.won[side]])
+			board.result = board.toMove;
+	}
+	else if ((squares | board.squares[1 - side][smallBoard]) == UltimateAllSquares)
+	{
+		board.closed |= (uint16_t)(1 << smallBoard);
+	}
+
+	if (board.result == UltimateOngoing && board.closed == UltimateAllSquares)
+		board.result = UltimateDraw;
+
+	board.next = (board.closed >> square) & 1 ? -1 : (int8_t)square;
+	board.toMove = OtherPiece(board.toMove);
+	board.moveCount++;
+}
+
+//every legal move, returns how many
+inline int UltimateMoves(const UltimateBoard& board, uint8_t* moves) noexcept
+{
+	if (board.result != UltimateOngoing)
+		return 0;
+
+	int count = 0;
+	int first = board.next < 0 ? 0 : board.next;
+	int last = board.next < 0 ? 8 : board.next;
+
+	for (int smallBoard = first; smallBoard <= last; smallBoard++)
+	{
+		for (uint16_t open = UltimateOpenSquares(board, smallBoard); open != 0; open &= open - 1)
+			moves[count++] = (uint8_t)(smallBoard * 9 + std::countr_zero(open));
+	}
+	return count;
+}
+
+//the index'th set bit
+[[nodiscard]]
+inline int UltimateNthBit(uint32_t bits, int index) noexcept
+{
+	for (int i = 0; i < index; i++)
+		bits &= bits - 1;
+	return std::countr_zero(bits);
+}
+
+//a uniformly random legal move without listing them all
+[[nodiscard]]
+inline int UltimateRandomMove(const UltimateBoard& board, uint64_t& random) noexcept
+{
+	if (board.next >= 0)
+	{
+		uint16_t open = UltimateOpenSquares(board, board.next);
+		int pick = (int)(((SplitMix64(random) & 0xFFFFFFFF) * (uint64_t)TicTacToeCounts[open]) >> 32);
+		return board.next * 9 + UltimateNthBit(open, pick);
+	}
+
+	int counts[9];
+	int total = 0;
+	for (int smallBoard = 0; smallBoard < 9; smallBoard++)
+	{
+		counts[smallBoard] = TicTacToeCounts[UltimateOpenSquares(board, smallBoard)];
+		total += counts[smallBoard];
+	}
+
+	int pick = (int)(((SplitMix64(random) & 0xFFFFFFFF) * (uint64_t)total) >> 32);
+	int smallBoard = 0;
+	while (pick >= counts[smallBoard])
+		pick -= counts[smallBoard++];
+
+	return smallBoard * 9 + UltimateNthBit(UltimateOpenSquares(board, smallBoard), pick);
+}
+
+//plays random moves to the end, returns the result
+[[nodiscard]]
+inline int8_t UltimatePlayout(UltimateBoard board, uint64_t& random) noexcept
+{
+	while (board.result == UltimateOngoing)
+		UltimatePlay(board, UltimateRandomMove(board, random));
+	return board.result;
+}
+
+struct UltimateLimits
+{
+	int64_t maxTimeNs = 100'000'000;
+	//0 for no limit, counted across all threads
+	uint64_t maxPlayouts = 0;
+	int threads = 1;
+	uint64_t seed = 1;
+	float exploration = 1.4f;
+	//each thread's tree stops growing when it has this many nodes, later playouts start from its leaves.
+	//never fewer than the root and all its children, or there'd be nothing to choose between
+	uint32_t nodesPerThread = 1 << 20;
+};
+
+struct UltimateResult
+{
+	int bestMove;
+	//of the best move, for the side to move
+	double winRate;
+	uint64_t playouts;
+	uint64_t nodes;
+	int64_t elapsedNs;
+};
+
+struct UltimateNode
+{
+	//for the side that made the move into this node, a draw counts half
+	float wins;
+	uint32_t visits;
+	uint32_t firstChild;
+	uint8_t childCount;
+	uint8_t move;
+	bool expanded;
+};
+
+//one thread's tree, grown from the root on its own so the threads never wait on each other
+struct UltimateTree
+{
+	std::vector<UltimateNode> nodes;
+	uint64_t playouts = 0;
+	uint64_t random = 0;
+};
+
+inline void UltimateGrow(UltimateTree& tree, const UltimateBoard& root, const UltimateLimits& limits, std::chrono::steady_clock::time_point deadline, std::atomic<uint64_t>& totalPlayouts, const std::atomic<bool>& stop) noexcept
+{
+	std::vector<UltimateNode>& nodes = tree.nodes;
+	nodes.push_back(UltimateNode{ .wins = 0, .visits = 0, .firstChild = 0, .childCount = 0, .move = 0, .expanded = false });
+
+	uint32_t path[UltimateMoveCount + 1];
+	int8_t movers[UltimateMoveCount + 1];
+
+	for (;;)
+	{
+		//checking the clock every playout would cost more than some playouts do
+		if ((tree.playouts & 63) == 0)
+		{
+			if (stop.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline)
+				break;
+			if (limits.maxPlayouts != 0 && totalPlayouts.load(std::memory_order_relaxed) >= limits.maxPlayouts)
+				break;
+		}
+
+		UltimateBoard board = root;
+		uint32_t current = 0;
+		int length = 0;
+		path[length] = 0;
+		movers[length++] = OtherPiece(root.toMove);
+
+		//down the tree by UCB1, taking any child that hasn't been tried yet first
+		while (nodes[current].expanded && board.result == UltimateOngoing)
+		{
+			const UltimateNode& parent = nodes[current];
+			float logVisits = std::log((float)parent.visits + 1.f);
+			uint32_t best = parent.firstChild;
+			float bestValue = -1.f;
+
+			for (uint32_t child = parent.firstChild; child < parent.firstChild + parent.childCount; child++)
+			{
+				const UltimateNode& node = nodes[child];
+				if (node.visits == 0)
+				{
+					best = child;
+					break;
+				}
+
+				float value = node.wins / (float)node.visits + limits.exploration * std::sqrt(logVisits / (float)node.visits);
+				if (value > bestValue)
+				{
+					bestValue = value;
+					best = child;
+				}
+			}
+
+			movers[length] = board.toMove;
+			UltimatePlay(board, nodes[best].move);
+			current = best;
+			path[length++] = current;
+		}
+
+		//a leaf gets its children the first time it's reached, as long as there's room
+		if (board.result == UltimateOngoing && !nodes[current].expanded)
+		{
+			uint8_t moves[UltimateMoveCount];
+			int moveCount = UltimateMoves(board, moves);
+
+			if (nodes.size() + (size_t)moveCount <= limits.nodesPerThread)
+			{
+				uint32_t firstChild = (uint32_t)nodes.size();
+				for (int i = 0; i < moveCount; i++)
+					nodes.push_back(UltimateNode{ .wins = 0, .visits = 0, .firstChild = 0, .childCount = 0, .move = moves[i], .expanded = false });
+
+				nodes[current].firstChild = firstChild;
+				nodes[current].childCount = (uint8_t)moveCount;
+				nodes[current].expanded = true;
+
+				uint32_t child = firstChild + (uint32_t)(SplitMix64(tree.random) % (uint64_t)moveCount);
+				movers[length] = board.toMove;
+				UltimatePlay(board, nodes[child].move);
+				current = child;
+				path[length++] = current;
+			}
+		}
+
+		int8_t result = board.result != UltimateOngoing ? board.result : UltimatePlayout(board, tree.random);
+
+		for (int i = 0; i < length; i++)
+		{
+			UltimateNode& node = nodes[path[i]];
+			node.visits++;
+			if (result == UltimateDraw)
+				node.wins += .5f;
+			else if (result == movers[i])
+				node.wins += 1.f;
+		}
+
+		tree.playouts++;
+		totalPlayouts.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+//Monte Carlo tree search on limits.threads threads, each with a tree of its own, whose root visits are added up at the end.
+//bestMove is -1 only if the game is already over
+[[nodiscard]]
+inline UltimateResult UltimateSearch(const UltimateBoard& root, const UltimateLimits& limits, const std::atomic<bool>* stop = nullptr)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	auto deadline = startTime + std::chrono::nanoseconds(limits.maxTimeNs > 0 ? limits.maxTimeNs : INT64_MAX / 4);
+
+	UltimateResult result = { .bestMove = -1, .winRate = 0, .playouts = 0, .nodes = 0, .elapsedNs = 0 };
+
+	uint8_t moves[UltimateMoveCount];
+	int moveCount = UltimateMoves(root, moves);
+	if (moveCount == 0)
+		return result;
+
+	//a tree too small to expand the root would spend the whole budget and still only have moves[0] to offer
+	UltimateLimits treeLimits = limits;
+	if (treeLimits.nodesPerThread < 1 + UltimateMoveCount)
+		treeLimits.nodesPerThread = 1 + UltimateMoveCount;
+
+	int threadCount = limits.threads < 1 ? 1 : limits.threads;
+	std::vector<UltimateTree> trees(threadCount);
+	std::atomic<uint64_t> totalPlayouts = 0;
+	std::atomic<bool> neverStop = false;
+	const std::atomic<bool>& stopFlag = stop != nullptr ? *stop : neverStop;
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		trees[i].random = limits.seed + (uint64_t)i * 0x9E3779B97F4A7C15ull;
+		trees[i].nodes.reserve(treeLimits.nodesPerThread);
+	}
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threadCount; i++)
+		workers.emplace_back(UltimateGrow, std::ref(trees[i]), std::cref(root), std::cref(treeLimits), deadline, std::ref(totalPlayouts), std::cref(stopFlag));
+
+	UltimateGrow(trees[0], root, treeLimits, deadline, totalPlayouts, stopFlag);
+
+	for (std::thread& worker : workers)
+		worker.join();
+
+	//every tree lists the root's moves in the same order
+	uint64_t visits[UltimateMoveCount] = {};
+	double wins[UltimateMoveCount] = {};
+
+	for (const UltimateTree& tree : trees)
+	{
+		result.playouts += tree.playouts;
+		result.nodes += tree.nodes.size();
+
+		const UltimateNode& rootNode = tree.nodes[0];
+		for (int i = 0; i < rootNode.childCount; i++)
+		{
+			const UltimateNode& child = tree.nodes[rootNode.firstChild + i];
+			visits[i] += child.visits;
+			wins[i] += child.wins;
+		}
+	}
+
+	//the most visited move, which is the one the search trusted most
+	int best = 0;
+	for (int i = 1; i < moveCount; i++)
+	{
+		if (visits[i] > visits[best])
+			best = i;
+	}
+
+	result.bestMove = moves[best];
+	result.winRate = visits[best] != 0 ? wins[best] / (double)visits[best] : 0;
+	result.elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+	return result;
+}